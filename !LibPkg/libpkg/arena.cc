@@ -0,0 +1,78 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+
+#include "libpkg/arena.h"
+
+namespace pkg {
+
+arena::arena():
+	_next(0),
+	_end(0),
+	_allocated(0)
+{}
+
+arena::~arena()
+{
+	release();
+}
+
+void* arena::allocate(std::size_t size,std::size_t align)
+{
+	// Align the next free byte.
+	std::size_t offset=reinterpret_cast<std::size_t>(_next)&(align-1);
+	char* p=(offset)?_next+(align-offset):_next;
+
+	if (!p||(size>static_cast<std::size_t>(_end-p)))
+	{
+		// Start a new block.  Blocks returned by malloc are suitably
+		// aligned for any type.  An oversized request is given a block
+		// of its own, so that the remainder of the current block is
+		// not wasted.
+		std::size_t bsize=(size>block_size/4)?size:block_size;
+
+		// Make room to record the block before it is allocated, so
+		// that it cannot be leaked if recording it fails.
+		if (_blocks.size()==_blocks.capacity())
+			_blocks.reserve(_blocks.empty()?16:_blocks.size()*2);
+		char* block=static_cast<char*>(std::malloc(bsize));
+		if (!block) throw std::bad_alloc();
+		_blocks.push_back(block);
+		_allocated+=size;
+		if (bsize!=block_size) return block;
+		_next=block+size;
+		_end=block+bsize;
+		return block;
+	}
+
+	_next=p+size;
+	_allocated+=size;
+	return p;
+}
+
+void arena::release()
+{
+	for (std::vector<char*>::iterator i=_blocks.begin();i!=_blocks.end();++i)
+		std::free(*i);
+	_blocks.clear();
+	_next=0;
+	_end=0;
+	_allocated=0;
+}
+
+}; /* namespace pkg */
@@ -0,0 +1,215 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_ARENA
+#define LIBPKG_ARENA
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace pkg {
+
+/** A class for allocating memory from a small number of large blocks.
+ * Individual allocations are never freed.  Instead, the whole of the
+ * memory allocated by the arena is freed in one step when it is
+ * released.  This is suitable for data that is built, used, then
+ * discarded as a whole, and avoids fragmenting the heap.
+ */
+class arena
+{
+private:
+	/** The blocks of memory owned by the arena. */
+	std::vector<char*> _blocks;
+
+	/** The next free byte in the current block. */
+	char* _next;
+
+	/** The end of the current block. */
+	char* _end;
+
+	/** The total number of bytes allocated from the arena. */
+	std::size_t _allocated;
+public:
+	/** The size of a normal block.
+	 * Larger requests are given a block of their own.
+	 */
+	static const std::size_t block_size=0x10000;
+
+	/** Construct arena. */
+	arena();
+
+	/** Destroy arena.
+	 * Any memory allocated from the arena is freed.
+	 */
+	~arena();
+
+	/** Allocate memory.
+	 * @param size the number of bytes required
+	 * @param align the required alignment, which must be a power of two
+	 * @return a pointer to the allocated memory
+	 */
+	void* allocate(std::size_t size,std::size_t align);
+
+	/** Release all memory allocated from the arena.
+	 * Any objects constructed in that memory must already have been
+	 * destroyed.
+	 */
+	void release();
+
+	/** Get the number of bytes allocated since the arena was last
+	 * released.
+	 * @return the number of bytes allocated
+	 */
+	std::size_t allocated() const
+		{ return _allocated; }
+
+	/** Get the number of blocks owned by the arena.
+	 * @return the number of blocks
+	 */
+	std::size_t blocks() const
+		{ return _blocks.size(); }
+private:
+	/** Prevent copying. */
+	arena(const arena&);
+
+	/** Prevent assignment. */
+	arena& operator=(const arena&);
+};
+
+/** An allocator which allocates memory from an arena.
+ * This can be used with the standard containers.  Deallocation has
+ * no effect: the memory is reclaimed when the arena is released.
+ */
+template<class T>
+class arena_allocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+
+	/** A class for obtaining an allocator for another type. */
+	template<class U>
+	struct rebind
+	{
+		typedef arena_allocator<U> other;
+	};
+private:
+	/** The arena from which memory is allocated. */
+	arena* _arena;
+
+	template<class U> friend class arena_allocator;
+public:
+	/** Construct arena allocator.
+	 * @param a the arena from which memory is to be allocated
+	 */
+	explicit arena_allocator(arena& a):
+		_arena(&a)
+	{}
+
+	/** Construct arena allocator from one for a different type.
+	 * @param alloc the allocator to be copied
+	 */
+	template<class U>
+	arena_allocator(const arena_allocator<U>& alloc):
+		_arena(alloc._arena)
+	{}
+
+	/** Allocate memory for an array of objects.
+	 * @param n the number of objects
+	 * @return a pointer to the allocated memory
+	 */
+	pointer allocate(size_type n,const void* hint=0)
+	{
+		return static_cast<pointer>(
+			_arena->allocate(n*sizeof(T),alignof(T)));
+	}
+
+	/** Deallocate memory.
+	 * This has no effect.
+	 * @param p a pointer to the memory
+	 * @param n the number of objects
+	 */
+	void deallocate(pointer p,size_type n)
+	{}
+
+	/** Construct object.
+	 * @param p a pointer to the memory for the object
+	 * @param args the constructor arguments
+	 */
+	template<class U,class... Args>
+	void construct(U* p,Args&&... args)
+	{
+		::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+
+	/** Destroy object.
+	 * @param p a pointer to the object
+	 */
+	template<class U>
+	void destroy(U* p)
+	{
+		p->~U();
+	}
+
+	/** Get address of object.
+	 * @param x the object
+	 * @return the address of the object
+	 */
+	pointer address(reference x) const
+		{ return &x; }
+
+	/** Get address of constant object.
+	 * @param x the object
+	 * @return the address of the object
+	 */
+	const_pointer address(const_reference x) const
+		{ return &x; }
+
+	/** Get maximum number of objects that could be allocated.
+	 * @return the maximum number of objects
+	 */
+	size_type max_size() const
+		{ return size_type(-1)/sizeof(T); }
+
+	/** Compare with another allocator.
+	 * Allocators are equal if they use the same arena.
+	 * @param rhs the allocator to compare with
+	 * @return true if equal, otherwise false
+	 */
+	template<class U>
+	bool operator==(const arena_allocator<U>& rhs) const
+		{ return _arena==rhs._arena; }
+
+	/** Compare with another allocator.
+	 * @param rhs the allocator to compare with
+	 * @return true if not equal, otherwise false
+	 */
+	template<class U>
+	bool operator!=(const arena_allocator<U>& rhs) const
+		{ return _arena!=rhs._arena; }
+};
+
+}; /* namespace pkg */
+
+#endif
@@ -82,7 +82,7 @@ int binary_control::install_priority() const
 {
 	if (_install_priority == 0)
 	{
-		const_iterator f=find("InstallPriority");
+		const_iterator f=find(field_installpriority);
 		if (f==end())
 		{
 			_install_priority = 0;
@@ -14,15 +14,193 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "zlib.h"
+
+#ifdef LIBPKG_PARALLEL_PARSE
+#include <ctype.h>
+#include <exception>
+#include <functional>
+#include <thread>
+#endif
 
 #include "libpkg/filesystem.h"
+#include "libpkg/commit_writer.h"
+#include "libpkg/env_checker.h"
 #include "libpkg/binary_control_table.h"
 
 namespace pkg {
 
+namespace {
+
+/** The magic number at the start of a package index snapshot. */
+const unsigned int snapshot_magic=0x49504b4c;
+
+/** The format version of a package index snapshot. */
+const unsigned int snapshot_format=2;
+
+/** The number of header words in a package index snapshot.
+ * These are: the magic number, the format version, the length, load
+ * address and execution address of the package index, the number of
+ * strings in the pool, the number of records and the checksum of the
+ * remainder of the snapshot.
+ */
+const unsigned int snapshot_header_words=8;
+
+/** Append 32-bit value to buffer in little-endian order.
+ * @param buffer the buffer
+ * @param value the value to be appended
+ */
+void write_32(string& buffer,unsigned int value)
+{
+	buffer.push_back(static_cast<char>(value&0xff));
+	buffer.push_back(static_cast<char>((value>>8)&0xff));
+	buffer.push_back(static_cast<char>((value>>16)&0xff));
+	buffer.push_back(static_cast<char>((value>>24)&0xff));
+}
+
+/** Read 32-bit value in little-endian order.
+ * @param p the position from which to read, which is advanced
+ * @param last the end of the buffer
+ * @param value a variable to receive the value
+ * @return true if the value was read, false if the buffer was too short
+ */
+bool read_32(const char*& p,const char* last,unsigned int& value)
+{
+	if (last-p<4) return false;
+	const unsigned char* q=reinterpret_cast<const unsigned char*>(p);
+	value=q[0]|(q[1]<<8)|(q[2]<<16)|(static_cast<unsigned int>(q[3])<<24);
+	p+=4;
+	return true;
+}
+
+/** Calculate the checksum of part of a snapshot.
+ * @param first the beginning of the data
+ * @param last the end of the data
+ * @return the checksum
+ */
+unsigned int snapshot_checksum(const char* first,const char* last)
+{
+	return crc32(crc32(0,Z_NULL,0),
+		reinterpret_cast<const Bytef*>(first),last-first);
+}
+
+/** A class for comparing the versions of binary control table records. */
+struct version_less
+{
+	typedef binary_control_table::const_iterator const_iterator;
+
+	bool operator()(const const_iterator& lhs,const version& rhs) const
+		{ return lhs->first.pkgvrsn<rhs; }
+
+	bool operator()(const version& lhs,const const_iterator& rhs) const
+		{ return lhs<rhs->first.pkgvrsn; }
+};
+
+/** Intern the values of the decoded standard fields of a control record.
+ * Fields for which decoding has been deferred are not affected.
+ * @param pool the string pool
+ * @param ctrl the control record
+ */
+void intern_fields(string_pool& pool,control& ctrl)
+{
+	for (unsigned int i=0;i!=control::field_count;++i)
+	{
+		control::field_type field=static_cast<control::field_type>(i);
+		if (control::deferred(field)) continue;
+		control::iterator f=ctrl.find(field);
+		if (f!=ctrl.end()) f->second=pool.intern(f->second);
+	}
+}
+
+}; /* anonymous namespace */
+
+#ifdef LIBPKG_PARALLEL_PARSE
+namespace {
+
+/** The minimum size of each chunk of a package index that is parsed
+ * by a separate thread. */
+const string::size_type min_chunk_size=0x40000;
+
+/** A chunk of a package index to be parsed by one thread. */
+struct parse_chunk
+{
+	/** The buffer containing the package index. */
+	std::shared_ptr<const string> source;
+
+	/** The offset of the beginning of the chunk. */
+	string::size_type first;
+
+	/** The offset of the end of the chunk. */
+	string::size_type last;
+
+	/** The control records parsed from the chunk, in order. */
+	std::vector<binary_control> records;
+
+	/** The exception thrown while parsing the chunk, if any. */
+	std::exception_ptr error;
+};
+
+/** Find the beginning of a blank line.
+ * The search begins at the start of the line following the one
+ * which contains first.  Since a blank line always terminates a
+ * control record, the result is a safe place to split the index.
+ * @param first the position from which to search
+ * @param last the end of the sequence
+ * @return the beginning of the blank line, or last if there is none
+ */
+string::const_iterator find_blank_line(string::const_iterator first,
+	string::const_iterator last)
+{
+	string::const_iterator p=std::find(first,last,'\n');
+	while (p!=last)
+	{
+		++p;
+		string::const_iterator q=p;
+		while ((q!=last)&&(*q!='\n')&&isspace(*q)) ++q;
+		if ((q==last)||(*q=='\n')) return p;
+		p=std::find(q,last,'\n');
+	}
+	return last;
+}
+
+/** Parse the control records in a chunk.
+ * Exceptions are caught and recorded in the chunk so that they can be
+ * rethrown by the thread that merges the results.
+ * @param chunk the chunk to be parsed
+ */
+void parse_records(parse_chunk& chunk)
+{
+	try
+	{
+		string::size_type p=chunk.first;
+		while (p!=chunk.last)
+		{
+			binary_control ctrl;
+			p=parse_control(chunk.source,p,chunk.last,ctrl);
+			if (!ctrl.empty()) chunk.records.push_back(ctrl);
+		}
+	}
+	catch (...)
+	{
+		chunk.error=std::current_exception();
+	}
+}
+
+}; /* anonymous namespace */
+#endif
+
+const unsigned int binary_control_table::no_rank;
+
 binary_control_table::binary_control_table(const string& pathname):
-	_pathname(pathname)
+	_pathname(pathname),
+	_data(std::less<key_type>(),data_type::allocator_type(_arena))
 {
 	update();
 }
@@ -34,7 +212,7 @@ const binary_control_table::mapped_type&
 	binary_control_table::operator[](const key_type& key) const
 {
 	static mapped_type default_value;
-	std::map<key_type,mapped_type>::const_iterator f=_data.find(key);
+	const_iterator f=_data.find(key);
 	return (f!=_data.end())?f->second:default_value;
 }
 
@@ -47,81 +225,474 @@ const binary_control_table::mapped_type&
 	binary_control_table::operator[](const string& pkgname) const
 {
 	static mapped_type default_value;
-	key_type key(pkgname,version(),string());
-	std::map<key_type,mapped_type>::const_iterator f=_data.lower_bound(key);
-	if (f==_data.end()) return default_value;
-	if (f->first.pkgname!=pkgname) return default_value;
-	const mapped_type* result=&f->second;
-	while ((++f!=_data.end())&&(f->first.pkgname==pkgname))
-		result=&f->second;
-	return *result;
+	const record_list& recs=records(pkgname);
+	if (recs.empty()) return default_value;
+	return recs.back()->second;
+}
+
+std::pair<binary_control_table::const_iterator,
+	binary_control_table::const_iterator>
+	binary_control_table::equal_range(const string& pkgname) const
+{
+	const record_list& recs=records(pkgname);
+	if (recs.empty()) return std::make_pair(_data.end(),_data.end());
+	return std::make_pair(recs.front(),std::next(recs.back()));
+}
+
+const binary_control_table::record_list& binary_control_table::records(
+	const string& pkgname) const
+{
+	static record_list default_value;
+	std::unordered_map<string,record_list>::const_iterator f=
+		_index.find(pkgname);
+	return (f!=_index.end())?f->second:default_value;
+}
+
+binary_control_table::const_iterator binary_control_table::satisfying(
+	const dependency& dep,bool available) const
+{
+	const record_list& recs=records(dep.pkgname());
+	record_list::const_iterator first=recs.begin();
+	record_list::const_iterator last=recs.end();
+
+	// Narrow the range to the records that satisfy the relation.
+	const version& v=dep.version();
+	switch (dep.relation())
+	{
+	case dependency::relation_al:
+		break;
+	case dependency::relation_eq:
+		first=std::lower_bound(first,last,v,version_less());
+		last=std::upper_bound(first,last,v,version_less());
+		break;
+	case dependency::relation_lt:
+		last=std::lower_bound(first,last,v,version_less());
+		break;
+	case dependency::relation_ge:
+		first=std::lower_bound(first,last,v,version_less());
+		break;
+	case dependency::relation_le:
+		last=std::upper_bound(first,last,v,version_less());
+		break;
+	case dependency::relation_gt:
+		first=std::upper_bound(first,last,v,version_less());
+		break;
+	}
+
+	// Take the last record in the range, skipping any for environments
+	// that are unavailable if required.
+	while (last!=first)
+	{
+		--last;
+		if (!available||(*last)->second.package_env()->available())
+			return *last;
+	}
+	return _data.end();
+}
+
+unsigned int binary_control_table::rank(const string& pkgname,
+	const string& pkgvrsn) const
+{
+	string rank_key;
+	rank_key.reserve(pkgname.length()+1+pkgvrsn.length());
+	rank_key.append(pkgname);
+	rank_key.push_back(' ');
+	rank_key.append(pkgvrsn);
+	std::unordered_map<string,unsigned int>::const_iterator f=
+		_ranks.find(rank_key);
+	if (f!=_ranks.end()) return f->second;
+
+	// The version string might be written differently from any in
+	// the table, so search for an equal version.
+	const record_list& recs=records(pkgname);
+	version v(pkgvrsn);
+	record_list::const_iterator g=
+		std::lower_bound(recs.begin(),recs.end(),v,version_less());
+	if ((g==recs.end())||((*g)->first.pkgvrsn!=v)) return no_rank;
+	return g-recs.begin();
+}
+
+const version& binary_control_table::ranked_version(const string& pkgname,
+	unsigned int rank) const
+{
+	static version default_value;
+	const record_list& recs=records(pkgname);
+	if (rank>=recs.size()) return default_value;
+	return recs[rank]->first.pkgvrsn;
 }
 
 void binary_control_table::insert(const mapped_type& ctrl)
 {
 	key_type key(ctrl.pkgname(),ctrl.version(), ctrl.environment_id());
-	_data[key]=ctrl;
-	notify();
+	mapped_type& stored=_data[key];
+	stored=ctrl;
+	intern_fields(_pool,stored);
+
+	// Re-index this package only.
+	const_iterator first=_data.find(key);
+	const_iterator last=first;
+	while ((first!=_data.begin())&&
+		(std::prev(first)->first.pkgname==key.pkgname)) --first;
+	while ((last!=_data.end())&&(last->first.pkgname==key.pkgname)) ++last;
+	build_index(first,last);
+	notify(key.pkgname);
 }
 
 void binary_control_table::update()
 {
-	_data.clear();
-	std::ifstream in(_pathname.c_str());
-	in.peek();
-	while (in&&!in.eof())
+	clear();
+	try
 	{
-		binary_control ctrl;
-		in >> ctrl;
-		string pkgname=ctrl.pkgname();
-		version pkgvrsn=ctrl.version();
-		string id = ctrl.environment_id();
-		key_type key(pkgname,pkgvrsn,id);
-		std::map<key_type,mapped_type>::const_iterator f=_data.find(key);
-		if (f==_data.end()) _data[key]=ctrl;
-		while (in.peek()=='\n') in.get();
+		if (!read_snapshot())
+		{
+			clear();
+			parse_index();
+		}
 	}
+	catch (...)
+	{
+		// Whatever was read before the error is kept.  The index must
+		// match it, and watchers must be told (so that they do not hold
+		// on to records which no longer exist) before the error is
+		// passed on.
+		build_index();
+		notify();
+		throw;
+	}
+	build_index();
 	notify();
 }
 
+void binary_control_table::parse_index()
+{
+	// Read the whole package index in one go, then parse the control
+	// records directly from memory.  The buffer is kept for as long as
+	// any record has fields that have not yet been decoded.
+	std::shared_ptr<string> buffer(new string);
+	read_file(_pathname,*buffer);
+	std::shared_ptr<const string> source(buffer);
+	string::size_type p=0;
+	string::size_type last=buffer->size();
+
+#ifdef LIBPKG_PARALLEL_PARSE
+	unsigned int threads=std::thread::hardware_concurrency();
+	unsigned int max_threads=last/min_chunk_size;
+	if (threads>max_threads) threads=max_threads;
+	if (threads>1)
+	{
+		// Split the index into chunks at blank lines.
+		std::vector<parse_chunk> chunks(threads);
+		for (unsigned int i=0;i!=threads;++i)
+		{
+			chunks[i].source=source;
+			chunks[i].first=p;
+			if (i+1!=threads)
+			{
+				string::size_type offset=last/threads*(i+1);
+				if (offset<p) offset=p;
+				p=find_blank_line(buffer->begin()+offset,buffer->end())-
+					buffer->begin();
+			}
+			else p=last;
+			chunks[i].last=p;
+		}
+
+		// Parse the first chunk in this thread and the others in
+		// worker threads.
+		std::vector<std::thread> workers;
+		for (unsigned int i=1;i!=threads;++i)
+			workers.push_back(std::thread(parse_records,std::ref(chunks[i])));
+		parse_records(chunks[0]);
+		for (unsigned int i=0;i!=workers.size();++i) workers[i].join();
+
+		// Merge the results in order, so that the first of any
+		// duplicates is kept just as it would be by a sequential parse.
+		// Environment identifiers are calculated here because the
+		// environment checker is not thread-safe.
+		for (unsigned int i=0;i!=threads;++i)
+		{
+			std::vector<binary_control>& records=chunks[i].records;
+			for (unsigned int j=0;j!=records.size();++j)
+			{
+				binary_control& ctrl=records[j];
+				key_type key(ctrl.pkgname(),ctrl.version(),
+					ctrl.environment_id());
+				if (_data.find(key)==_data.end())
+				{
+					intern_fields(_pool,ctrl);
+					_data.insert(std::make_pair(key,ctrl));
+				}
+			}
+			if (chunks[i].error) std::rethrow_exception(chunks[i].error);
+		}
+		write_snapshot();
+		return;
+	}
+#endif
+
+	while (p!=last)
+	{
+		binary_control ctrl;
+		p=parse_control(source,p,last,ctrl,&_pool);
+
+		// Skip blank lines between records.
+		if (ctrl.empty()) continue;
+
+		key_type key(ctrl.pkgname(),ctrl.version(),ctrl.environment_id());
+		if (_data.find(key)==_data.end())
+			_data.insert(std::make_pair(key,ctrl));
+	}
+	write_snapshot();
+}
+
 void binary_control_table::commit()
 {
 	// Take no action unless a pathname has been specified.
 	if (_pathname.size())
 	{
-		// Set pathnames.
-		string dst_pathname=_pathname;
-		string tmp_pathname=_pathname+string("++");
-		string bak_pathname=_pathname+string("--");
-
-		// Write new control file.
-		std::ofstream out(tmp_pathname.c_str());
+		// Write new control file, then move it into place.  Writing
+		// a record does not cause its deferred fields to be decoded.
+		commit_writer writer(_pathname);
+		std::ostream& out=writer.out();
 		for (const_iterator i=_data.begin();i!=_data.end();++i)
 		{
-			out << i->second << std::endl;
+			out << i->second << '\n';
 		}
-		out.close();
-		if (!out) throw commit_error();
-	
-		try
+		if (!writer.commit()) throw commit_error();
+
+		// Replace the snapshot, which is now out of date.
+		write_snapshot();
+	}
+}
+
+void binary_control_table::clear()
+{
+	// The nodes are destroyed individually, but their memory is not
+	// freed until the arena is released.
+	_data.clear();
+	_arena.release();
+	_pool.clear();
+	_index.clear();
+	_ranks.clear();
+}
+
+void binary_control_table::build_index()
+{
+	const_iterator first=_data.begin();
+	while (first!=_data.end())
+	{
+		const_iterator last=first;
+		while ((last!=_data.end())&&
+			(last->first.pkgname==first->first.pkgname)) ++last;
+		build_index(first,last);
+		first=last;
+	}
+}
+
+void binary_control_table::build_index(const_iterator first,
+	const_iterator last)
+{
+	if (first==last) return;
+	const string& pkgname=first->first.pkgname;
+	record_list& recs=_index[pkgname];
+	recs.clear();
+
+	// Records are ordered by version, so equal versions (which
+	// differ only by environment) are adjacent.
+	string prefix=pkgname+string(" ");
+	unsigned int rank=0;
+	for (;first!=last;++first)
+	{
+		const version& pkgvrsn=first->first.pkgvrsn;
+		if (recs.empty()||(recs.back()->first.pkgvrsn!=pkgvrsn))
+			rank=recs.size();
+		recs.push_back(first);
+		_ranks[prefix+first->second.version()]=rank;
+		_ranks[prefix+string(pkgvrsn)]=rank;
+	}
+}
+
+string binary_control_table::snapshot_pathname() const
+{
+	return _pathname+string("/idx");
+}
+
+bool binary_control_table::read_snapshot()
+{
+	// Take no action unless the package index exists.
+	if (!_pathname.size()) return false;
+	if (object_type(_pathname)!=1) return false;
+	unsigned int length=object_length(_pathname);
+	unsigned int loadaddr=0;
+	unsigned int execaddr=0;
+	read_file_info(_pathname,loadaddr,execaddr);
+
+	// The snapshot is kept in memory for as long as any record has
+	// fields that have not yet been decoded.
+	std::shared_ptr<string> buffer(new string);
+	read_file(snapshot_pathname(),*buffer);
+	if (buffer->size()<snapshot_header_words*4) return false;
+	std::shared_ptr<const string> source(buffer);
+	const char* first=buffer->data();
+	const char* p=first;
+	const char* last=p+buffer->size();
+
+	// Check that the snapshot was made from the current package index.
+	unsigned int header[snapshot_header_words];
+	for (unsigned int i=0;i!=snapshot_header_words;++i)
+		read_32(p,last,header[i]);
+	if ((header[0]!=snapshot_magic)||(header[1]!=snapshot_format)||
+		(header[2]!=length)||(header[3]!=loadaddr)||(header[4]!=execaddr))
+		return false;
+	if (header[7]!=snapshot_checksum(p,last)) return false;
+
+	// Read string pool.  Each value is interned once here, and the
+	// records then share the interned copy.
+	std::vector<const shared_string*> pool;
+	pool.reserve(header[5]);
+	for (unsigned int i=0;i!=header[5];++i)
+	{
+		unsigned int size=0;
+		if (!read_32(p,last,size)) return false;
+		if (static_cast<unsigned int>(last-p)<size) return false;
+		pool.push_back(&_pool.intern(string(p,size)));
+		p+=size;
+	}
+
+	// Read records.  The field names are converted to keys only once.
+	std::map<unsigned int,control::key_type> names;
+	for (unsigned int i=0;i!=header[6];++i)
+	{
+		binary_control ctrl;
+		unsigned int count=0;
+		if (!read_32(p,last,count)) break;
+		for (unsigned int j=0;j!=count;++j)
 		{
-			// Backup existing control file if it exists.
-			if (object_type(dst_pathname)!=0)
+			unsigned int name=0;
+			unsigned int value=0;
+			if (!read_32(p,last,name)||!read_32(p,last,value)||
+				(name>=pool.size())||(value>=pool.size()))
 			{
-				force_move(dst_pathname,bak_pathname,true);
+				return false;
 			}
-		
-			// Move new control file to destination.
-			force_move(tmp_pathname,dst_pathname,false);
-		
-			// Delete backup.
-			force_delete(bak_pathname);
+			std::map<unsigned int,control::key_type>::iterator f=
+				names.find(name);
+			if (f==names.end()) f=names.insert(
+				std::make_pair(name,control::key_type(*pool[name]))).first;
+			ctrl[f->second]=*pool[value];
+		}
+
+		// The remaining fields are left in control file format, to be
+		// decoded when they are needed.
+		unsigned int size=0;
+		if (!read_32(p,last,size)||(static_cast<unsigned int>(last-p)<size))
+		{
+			return false;
 		}
-		catch (...)
+		ctrl.defer(source,p-first,p-first+size);
+		p+=size;
+
+		// Records were written in key order, so each belongs at the end.
+		key_type key(ctrl.pkgname(),ctrl.version(),ctrl.environment_id());
+		_data.insert(_data.end(),std::make_pair(key,ctrl));
+	}
+	if ((p!=last)||(_data.size()!=header[6]))
+	{
+		return false;
+	}
+	return true;
+}
+
+void binary_control_table::write_snapshot()
+{
+	// Take no action unless the package index exists.
+	if (!_pathname.size()) return;
+	if (object_type(_pathname)!=1) return;
+	unsigned int length=object_length(_pathname);
+	unsigned int loadaddr=0;
+	unsigned int execaddr=0;
+	read_file_info(_pathname,loadaddr,execaddr);
+
+	// Build the string pool and records.  Each distinct string is
+	// stored once, no matter how many records it appears in.  Fields
+	// that are decoded on demand are stored in control file format,
+	// copied from the package index if they have not been decoded so
+	// that writing the snapshot does not cause them to be.
+	std::map<string,unsigned int> indices;
+	string pool;
+	string records;
+	string fields;
+	std::ostringstream deferred_fields;
+	for (const_iterator i=_data.begin();i!=_data.end();++i)
+	{
+		const binary_control& ctrl=i->second;
+		unsigned int count=0;
+		fields.clear();
+		for (unsigned int f=0;f!=control::field_count;++f)
 		{
-			throw commit_error();
+			control::field_type field=static_cast<control::field_type>(f);
+			if (control::deferred(field)) continue;
+			binary_control::const_iterator j=ctrl.find(field);
+			if (j==ctrl.end()) continue;
+			const string* strings[2]={&j->first,&j->second.str()};
+			for (unsigned int k=0;k!=2;++k)
+			{
+				std::map<string,unsigned int>::iterator s=
+					indices.find(*strings[k]);
+				if (s==indices.end())
+				{
+					s=indices.insert(std::make_pair(*strings[k],
+						static_cast<unsigned int>(indices.size()))).first;
+					write_32(pool,strings[k]->size());
+					pool.append(*strings[k]);
+				}
+				write_32(fields,s->second);
+			}
+			++count;
 		}
+		write_32(records,count);
+		records.append(fields);
+
+		deferred_fields.str(string());
+		ctrl.write_deferred(deferred_fields);
+		string text=deferred_fields.str();
+		write_32(records,text.size());
+		records.append(text);
+	}
+
+	// Assemble the snapshot.
+	string buffer;
+	buffer.reserve(snapshot_header_words*4+pool.size()+records.size());
+	write_32(buffer,snapshot_magic);
+	write_32(buffer,snapshot_format);
+	write_32(buffer,length);
+	write_32(buffer,loadaddr);
+	write_32(buffer,execaddr);
+	write_32(buffer,indices.size());
+	write_32(buffer,_data.size());
+	write_32(buffer,0);
+	buffer.append(pool);
+	buffer.append(records);
+	unsigned int checksum=snapshot_checksum(
+		buffer.data()+snapshot_header_words*4,buffer.data()+buffer.size());
+	string checksum_bytes;
+	write_32(checksum_bytes,checksum);
+	buffer.replace((snapshot_header_words-1)*4,4,checksum_bytes);
+
+	// Write the snapshot to a temporary file, then move it into place.
+	try
+	{
+		string dst_pathname=snapshot_pathname();
+		string tmp_pathname=dst_pathname+string("++");
+		std::ofstream out(tmp_pathname.c_str(),
+			std::ios::out|std::ios::binary);
+		out.write(buffer.data(),buffer.size());
+		out.close();
+		if (out) force_move(tmp_pathname,dst_pathname,true);
+		else force_delete(tmp_pathname);
 	}
+	catch (...)
+	{}
 }
 
 binary_control_table::key_type::key_type()
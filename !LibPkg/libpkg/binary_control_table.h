@@ -19,9 +19,14 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "libpkg/version.h"
+#include "libpkg/arena.h"
+#include "libpkg/dependency.h"
 #include "libpkg/binary_control.h"
+#include "libpkg/string_pool.h"
 #include "libpkg/table.h"
 
 namespace pkg {
@@ -53,14 +58,92 @@ public:
 		key_type(const string& _pkgname,const version& _pkgvrsn, const string &_pkgenv);
 	};
 	typedef binary_control mapped_type;
-	typedef std::map<key_type,mapped_type>::const_iterator const_iterator;
+private:
+	/** The type of the map from key to control record.
+	 * Its nodes are allocated from an arena, so that all of them can be
+	 * freed in one step when the table is updated.
+	 */
+	typedef std::map<key_type,mapped_type,std::less<key_type>,
+		arena_allocator<std::pair<const key_type,mapped_type> > > data_type;
+public:
+	typedef data_type::const_iterator const_iterator;
+
+	/** The type of a list of the records for one package.
+	 * The records are in ascending order of version, then environment.
+	 */
+	typedef std::vector<const_iterator> record_list;
 	class commit_error;
+
+	/** A rank which indicates that a version is not in the table. */
+	static const unsigned int no_rank=static_cast<unsigned int>(-1);
 private:
 	/** The pathname of the underlying package index file. */
 	string _pathname;
 
+	/** The arena from which the nodes of _data are allocated.
+	 * This must be constructed before, and destroyed after, _data.
+	 */
+	arena _arena;
+
 	/** A map from package name and version to control record. */
-	std::map<key_type,mapped_type> _data;
+	data_type _data;
+
+	/** The pool of field values shared between control records. */
+	string_pool _pool;
+
+	/** A map from package name to the records for that package. */
+	std::unordered_map<string,record_list> _index;
+
+	/** A map from package name and version string, separated by a
+	 * space, to rank.
+	 * Both the version string from the control record and the
+	 * canonical form of the version are included.
+	 */
+	std::unordered_map<string,unsigned int> _ranks;
+
+	/** Index and rank the records of every package in the table. */
+	void build_index();
+
+	/** Index and rank the records of one package.
+	 * @param first the first record for the package
+	 * @param last the end of the records for the package
+	 */
+	void build_index(const_iterator first,const_iterator last);
+
+	/** Remove all control records from the table.
+	 * All memory used by the previous generation of records is
+	 * freed.  Watchers are not notified.
+	 */
+	void clear();
+
+	/** Get the pathname of the snapshot of the package index.
+	 * The snapshot holds the content of the table in a binary form
+	 * that can be loaded without parsing the package index.
+	 * @return the pathname of the snapshot
+	 */
+	string snapshot_pathname() const;
+
+	/** Load the table from the snapshot.
+	 * The snapshot is used only if it was made from a package index
+	 * with the same length and timestamp as the current one, and if
+	 * its checksum is correct.  If it is not used then the table may
+	 * be left partly filled.
+	 * @return true if the table was loaded, otherwise false
+	 */
+	bool read_snapshot();
+
+	/** Load the table by parsing the package index.
+	 * A new snapshot is written if the whole index was parsed.  If a
+	 * parse error is found then the records before it are left in the
+	 * table, and the error is thrown.
+	 */
+	void parse_index();
+
+	/** Write a snapshot of the table.
+	 * Failure to write the snapshot is not an error, because the
+	 * package index can always be parsed instead.
+	 */
+	void write_snapshot();
 public:
 	/** Construct binary control table.
 	 * @param pathname the pathname of the underlying package index file.
@@ -84,11 +167,21 @@ public:
 	bool contains(const key_type& key) const;
 
 	/** Get control record for latest version of package.
+	 * The record is found using the package index, so the time taken
+	 * does not depend on the number of versions of the package.
 	 * @param pkgname the package name
 	 * @return the control record
 	 */
 	const mapped_type& operator[](const string& pkgname) const;
 
+	/** Get the range of records for a package.
+	 * @param pkgname the package name
+	 * @return a pair of const iterators for the beginning and end of
+	 *  the range, which is empty if there are no records for the package
+	 */
+	std::pair<const_iterator,const_iterator> equal_range(
+		const string& pkgname) const;
+
 	/** Get const iterator for start of table.
 	 * @return the const iterator
 	 */
@@ -101,9 +194,69 @@ public:
 	const_iterator end() const
 		{ return _data.end(); }
 
+	/** Get the pool of field values shared between control records.
+	 * Values of standard fields that are decoded at load time are
+	 * interned when the table is updated or a record is inserted.
+	 * @return the string pool
+	 */
+	const string_pool& pool() const
+		{ return _pool; }
+
+	/** Get the records for a package.
+	 * @param pkgname the package name
+	 * @return the records, in ascending order of version then
+	 *  environment
+	 */
+	const record_list& records(const string& pkgname) const;
+
+	/** Find the latest version of a package that satisfies a dependency.
+	 * The records for the package are searched by bisection, so the
+	 * time taken is logarithmic in the number of versions unless
+	 * most of the satisfying records are unavailable.
+	 * If there is more than one record for that version then the one
+	 * for the environment that sorts last is chosen.
+	 * @param dep the dependency
+	 * @param available true if only records for environments that are
+	 *  available should be considered, otherwise false
+	 * @return the record, or end() if none satisfies the dependency
+	 */
+	const_iterator satisfying(const dependency& dep,
+		bool available=false) const;
+
+	/** Get the rank of a version of a package.
+	 * Each distinct version of a package in the table is given a rank,
+	 * which is the position in records() of the first record for that
+	 * version.  Two versions of the same package can therefore be
+	 * compared by comparing their ranks.  Versions that compare as
+	 * equal have the same rank.
+	 *
+	 * Ranks are assigned when the table is updated, and those of a
+	 * package are reassigned when a record for it is inserted, so they
+	 * should not be kept once the table has changed.
+	 *
+	 * A version string that appears in the table is found without
+	 * being parsed.  Any other version string is parsed and looked
+	 * for by binary search.
+	 * @param pkgname the package name
+	 * @param pkgvrsn the package version
+	 * @return the rank, or no_rank if the table has no record for
+	 *  that version of the package
+	 */
+	unsigned int rank(const string& pkgname,const string& pkgvrsn) const;
+
+	/** Get the version of a package with a given rank.
+	 * @param pkgname the package name
+	 * @param rank the rank
+	 * @return the version, or the default version if there is no
+	 *  record for the package at that position
+	 */
+	const version& ranked_version(const string& pkgname,
+		unsigned int rank) const;
+
 	/** Insert control record into table.
 	 * The inserted control record will disappear
 	 * when the table is next updated.
+	 * Watchers are given the package name as the key of the change.
 	 * @param ctrl the control record
 	 */
 	void insert(const mapped_type& ctrl);
@@ -115,7 +268,19 @@ public:
 	 */
 	void commit();
 
-	/** Re-read the underlying package index file. */
+	/** Re-read the underlying package index file.
+	 * If there is an up to date snapshot of the package index then it
+	 * is loaded in place of the text file.  Otherwise the text file is
+	 * parsed and a new snapshot is written.
+	 * If LibPkg was built with LIBPKG_PARALLEL_PARSE defined then a
+	 * large index is split into chunks at record boundaries, and the
+	 * chunks are parsed concurrently.  Either way, the first of any
+	 * records with the same key is the one kept.
+	 *
+	 * If the package index cannot be parsed then the records before
+	 * the error are kept, watchers are notified, and the error is
+	 * then thrown.
+	 */
 	void update();
 };
 
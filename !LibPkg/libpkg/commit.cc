@@ -131,6 +131,7 @@ void commit::poll()
 			component_update update(_pb.component_update_pathname());
 			bool paths_updated = true, paths_modified = false;
 			path_table &paths = _pb.paths();
+			table::batch paths_batch(paths);
 
 			// A path change may change the default for another component, so loop until
 			// no more changes are required.
@@ -225,7 +226,7 @@ void commit::poll()
 			{
 				// Create an entry in the progress table.
 				size_type size=npos;
-				control::const_iterator f=ctrl.find("Size");
+				control::const_iterator f=ctrl.find(control::field_size);
 				if (f!=ctrl.end())
 				{
 					std::istringstream in(f->second);
@@ -0,0 +1,113 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libpkg/filesystem.h"
+#include "libpkg/commit_writer.h"
+
+namespace pkg {
+
+commit_writer::file_buffer::file_buffer(std::size_t size):
+	_buffer(size),
+	_writes(0)
+{
+	setp(&_buffer[0],&_buffer[0]+_buffer.size());
+}
+
+bool commit_writer::file_buffer::open(const string& pathname)
+{
+	// The file must be made unbuffered before it is opened.
+	_file.pubsetbuf(0,0);
+	return _file.open(pathname.c_str(),std::ios::out|std::ios::trunc)!=0;
+}
+
+bool commit_writer::file_buffer::close()
+{
+	bool done=write();
+	return (_file.close()!=0)&&done;
+}
+
+commit_writer::file_buffer::int_type
+	commit_writer::file_buffer::overflow(int_type ch)
+{
+	if (!write()) return traits_type::eof();
+	if (!traits_type::eq_int_type(ch,traits_type::eof()))
+	{
+		*pptr()=traits_type::to_char_type(ch);
+		pbump(1);
+	}
+	return traits_type::not_eof(ch);
+}
+
+int commit_writer::file_buffer::sync()
+{
+	return (write())?0:-1;
+}
+
+bool commit_writer::file_buffer::write()
+{
+	std::streamsize count=pptr()-pbase();
+	if (!count) return true;
+	setp(&_buffer[0],&_buffer[0]+_buffer.size());
+	++_writes;
+	return _file.sputn(&_buffer[0],count)==count;
+}
+
+commit_writer::commit_writer(const string& pathname,std::size_t size):
+	_pathname(pathname),
+	_buffer(size),
+	_out(&_buffer)
+{
+	if (!_buffer.open(_pathname+string("++")))
+		_out.setstate(std::ios::badbit);
+}
+
+commit_writer::~commit_writer()
+{}
+
+bool commit_writer::commit()
+{
+	// Set pathnames.
+	string dst_pathname=_pathname;
+	string tmp_pathname=_pathname+string("++");
+	string bak_pathname=_pathname+string("--");
+
+	// Write any remaining content to the new file.
+	_out.flush();
+	if (!_buffer.close()||!_out) return false;
+
+	try
+	{
+		// Backup existing file if it exists.
+		if (object_type(dst_pathname)!=0)
+		{
+			force_move(dst_pathname,bak_pathname,true);
+		}
+
+		// Move new file to destination.
+		force_move(tmp_pathname,dst_pathname,false);
+
+		// Delete backup.
+		force_delete(bak_pathname);
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+}; /* namespace pkg */
@@ -0,0 +1,140 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_COMMIT_WRITER
+#define LIBPKG_COMMIT_WRITER
+
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace pkg {
+
+using std::string;
+
+/** A class for writing a file that replaces an existing one.
+ * The content is written to a temporary file through a large buffer,
+ * so that it reaches the filing system in a few large writes rather than
+ * one per line.  (For this to be effective, lines should be ended with
+ * '\n' rather than std::endl.)  When the content is complete, commit()
+ * moves the temporary file into place, keeping a backup of the existing
+ * file until the move has succeeded.
+ *
+ * If the writer is destroyed without being committed then the existing
+ * file is left unchanged.
+ */
+class commit_writer
+{
+private:
+	/** A stream buffer which passes its content to a file in blocks.
+	 * The file itself is unbuffered, so each block is passed to the
+	 * filing system by a single write operation.
+	 */
+	class file_buffer:
+		public std::streambuf
+	{
+	private:
+		/** The buffer. */
+		std::vector<char> _buffer;
+
+		/** The file. */
+		std::filebuf _file;
+
+		/** The number of write operations. */
+		unsigned int _writes;
+	public:
+		/** Construct file buffer.
+		 * @param size the buffer size
+		 */
+		file_buffer(std::size_t size);
+
+		/** Open file.
+		 * @param pathname the pathname of the file
+		 * @return true if the file was opened, otherwise false
+		 */
+		bool open(const string& pathname);
+
+		/** Write any remaining content, then close the file.
+		 * @return true if the content was written and the file closed,
+		 *  otherwise false
+		 */
+		bool close();
+
+		/** Get the number of write operations.
+		 * @return the number of writes
+		 */
+		unsigned int writes() const
+			{ return _writes; }
+	protected:
+		virtual int_type overflow(int_type ch);
+		virtual int sync();
+	private:
+		/** Write the content of the buffer to the file.
+		 * @return true if successful, otherwise false
+		 */
+		bool write();
+	};
+
+	/** The pathname of the file to be replaced. */
+	string _pathname;
+
+	/** The buffer for the temporary file. */
+	file_buffer _buffer;
+
+	/** The stream for writing to the temporary file. */
+	std::ostream _out;
+public:
+	/** The default size of the buffer. */
+	static const std::size_t buffer_size=0x10000;
+
+	/** Construct commit writer.
+	 * @param pathname the pathname of the file to be replaced
+	 * @param size the size of the buffer
+	 */
+	commit_writer(const string& pathname,std::size_t size=buffer_size);
+
+	/** Destroy commit writer. */
+	~commit_writer();
+
+	/** Get the stream to which the content should be written.
+	 * @return the output stream
+	 */
+	std::ostream& out()
+		{ return _out; }
+
+	/** Get the number of write operations made to the temporary file.
+	 * @return the number of writes
+	 */
+	unsigned int writes() const
+		{ return _buffer.writes(); }
+
+	/** Replace the file with the content that has been written.
+	 * @return true if the file was replaced, otherwise false
+	 */
+	bool commit();
+private:
+	/** Prevent copying. */
+	commit_writer(const commit_writer&);
+
+	/** Prevent assignment. */
+	commit_writer& operator=(const commit_writer&);
+};
+
+}; /* namespace pkg */
+
+#endif
@@ -17,6 +17,7 @@
 #include <fstream>
 
 #include "libpkg/filesystem.h"
+#include "libpkg/commit_writer.h"
 #include "libpkg/component_update.h"
 
 namespace pkg {
@@ -81,38 +82,14 @@ void component_update::commit()
 	// Take no action unless a pathname has been specified.
 	if (_pathname.size())
 	{
-		// Set pathnames.
-		string dst_pathname=_pathname;
-		string tmp_pathname=_pathname+string("++");
-		string bak_pathname=_pathname+string("--");
-	
-		// Write new status file.
-		std::ofstream out(tmp_pathname.c_str());
+		// Write new component update file, then move it into place.
+		commit_writer writer(_pathname);
+		std::ostream& out=writer.out();
 		for (const_iterator i=_data.begin();i!=_data.end();++i)
 		{
-				out << *i << std::endl;
-		}
-		out.close();
-		if (!out) throw commit_error();
-	
-		try
-		{
-			// Backup existing status file if it exists.
-			if (object_type(dst_pathname)!=0)
-			{
-				force_move(dst_pathname,bak_pathname,true);
-			}
-		
-			// Move new status file to destination.
-			force_move(tmp_pathname,dst_pathname,false);
-		
-			// Delete backup.
-			force_delete(bak_pathname);
-		}
-		catch (...)
-		{
-			throw commit_error();
+				out << *i << '\n';
 		}
+		if (!writer.commit()) throw commit_error();
 	}
 }
 
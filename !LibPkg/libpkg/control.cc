@@ -17,6 +17,8 @@
 #include <iostream>
 
 #include "libpkg/control.h"
+#include "libpkg/control_cursor.h"
+#include "libpkg/string_pool.h"
 
 namespace pkg {
 
@@ -27,89 +29,367 @@ static string to_lower(string value)
 	return value;
 }
 
-control::control()
-{}
+/** Write a field in control file format.
+ * @param out the output stream
+ * @param name the field name
+ * @param value the field value
+ */
+static void write_field(std::ostream& out,const string& name,
+	const string& value)
+{
+	out << name << ':';
+	string::size_type i=0;
+	string::size_type f=value.find('\n',i);
+	while (f!=string::npos)
+	{
+		if ((f==i)&&(i!=0))
+			out << " .\n";
+		else
+		{
+			out << ' ';
+			out.write(value.data()+i,f-i);
+			out << '\n';
+		}
+		i=f+1;
+		f=value.find('\n',i);
+	}
+	if ((value.length()==i)&&(i!=0))
+		out << " .\n";
+	else
+	{
+		out << ' ';
+		out.write(value.data()+i,value.length()-i);
+		out << '\n';
+	}
+}
+
+namespace {
+
+/** The standard field names, in lower case, indexed by field_type. */
+const char* const field_names[control::field_count]={
+	"package",
+	"version",
+	"standards-version",
+	"description",
+	"depends",
+	"recommends",
+	"suggests",
+	"conflicts",
+	"url",
+	"components",
+	"environment",
+	"osdepends",
+	"md5sum",
+	"size",
+	"source",
+	"maintainer",
+	"installed-size",
+	"section",
+	"priority",
+	"installpriority",
+	"licence"};
+
+/** A perfect hash table for the standard field names.
+ * The hash function is field_hash(), and every standard field name
+ * maps to a different slot.  Empty slots contain field_count.
+ */
+const control::field_type field_slots[64]={
+	control::field_package,control::field_description,
+	control::field_count,control::field_standards_version,
+	control::field_osdepends,control::field_version,
+	control::field_count,control::field_count,
+	control::field_count,control::field_size,
+	control::field_count,control::field_source,
+	control::field_count,control::field_count,
+	control::field_count,control::field_count,
+	control::field_installpriority,control::field_recommends,
+	control::field_count,control::field_suggests,
+	control::field_conflicts,control::field_components,
+	control::field_depends,control::field_count,
+	control::field_count,control::field_count,
+	control::field_count,control::field_md5sum,
+	control::field_count,control::field_count,
+	control::field_count,control::field_count,
+	control::field_count,control::field_count,
+	control::field_count,control::field_environment,
+	control::field_count,control::field_priority,
+	control::field_count,control::field_count,
+	control::field_count,control::field_count,
+	control::field_count,control::field_installed_size,
+	control::field_count,control::field_count,
+	control::field_count,control::field_count,
+	control::field_licence,control::field_count,
+	control::field_count,control::field_url,
+	control::field_count,control::field_count,
+	control::field_count,control::field_count,
+	control::field_maintainer,control::field_section,
+	control::field_count,control::field_count,
+	control::field_count,control::field_count,
+	control::field_count,control::field_count};
+
+/** Calculate hash of field name.
+ * The result depends only on the length, first character and last
+ * character of the name, and is not sensitive to case.
+ * @param name the field name (which must not be empty)
+ * @param length the length of the field name
+ * @return the hash value, in the range 0 to 63
+ */
+inline unsigned int field_hash(const char* name,string::size_type length)
+{
+	unsigned int first=tolower(static_cast<unsigned char>(name[0]));
+	unsigned int last=tolower(static_cast<unsigned char>(name[length-1]));
+	return (length+first*4+last*5)&63;
+}
+
+/** Convert the standard field names to strings.
+ * @return an array of field names, indexed by field_type
+ */
+const string* init_field_names()
+{
+	static string names[control::field_count];
+	for (unsigned int i=0;i!=control::field_count;++i)
+		names[i]=field_names[i];
+	return names;
+}
+
+}; /* anonymous namespace */
+
+control::control():
+	_deferred_first(0),
+	_deferred_last(0)
+{
+	index_fields();
+}
+
+control::control(const control& ctrl):
+	_data(ctrl._data),
+	_deferred(ctrl._deferred),
+	_deferred_first(ctrl._deferred_first),
+	_deferred_last(ctrl._deferred_last)
+{
+	index_fields();
+}
 
 control::~control()
 {}
 
-control::const_iterator control::find(key_type key) const
+control& control::operator=(const control& ctrl)
 {
-	key._priority=priority(to_lower(key));
-	return _data.find(key);
+	_data=ctrl._data;
+	_deferred=ctrl._deferred;
+	_deferred_first=ctrl._deferred_first;
+	_deferred_last=ctrl._deferred_last;
+	index_fields();
+	return *this;
 }
 
-control::iterator control::find(key_type key)
+control::const_iterator control::find(const key_type& key) const
 {
-	key._priority=priority(to_lower(key));
-	return _data.find(key);
+	if (deferred(key._field)) decode();
+	if (key._field!=field_count) return _fields[key._field];
+	key_type lkey(key);
+	lkey._priority=priority(to_lower(key));
+	return _data.find(lkey);
 }
 
-control::mapped_type& control::operator[](key_type key)
+control::iterator control::find(const key_type& key)
 {
-	key._priority=priority(to_lower(key));
-	return _data[key];
+	if (deferred(key._field)) decode();
+	if (key._field!=field_count) return _fields[key._field];
+	key_type lkey(key);
+	lkey._priority=priority(to_lower(key));
+	return _data.find(lkey);
+}
+
+control::mapped_type& control::operator[](const key_type& key)
+{
+	decode();
+	if (key._field!=field_count)
+	{
+		// Standard fields are located using the slot table, and
+		// only need to be given a priority when they are created.
+		iterator& f=_fields[key._field];
+		if (f==_data.end())
+		{
+			static const string* names=init_field_names();
+			key_type lkey(key);
+			lkey._priority=priority(names[key._field]);
+			f=_data.insert(std::make_pair(lkey,mapped_type())).first;
+		}
+		return f->second;
+	}
+	key_type lkey(key);
+	lkey._priority=priority(to_lower(key));
+	return _data[lkey];
 }
 
 void control::clear()
 {
 	_data.clear();
+	_deferred.reset();
+	index_fields();
+}
+
+void control::defer(const std::shared_ptr<const string>& source,
+	string::size_type first,string::size_type last)
+{
+	decode();
+	if (first==last) return;
+	_deferred=source;
+	_deferred_first=first;
+	_deferred_last=last;
+}
+
+void control::decode() const
+{
+	if (!_deferred) return;
+
+	// Release the buffer before decoding, so that insertion of the
+	// decoded fields does not cause this function to be re-entered.
+	// The content of the control file is logically unchanged, so it is
+	// safe to cast away constness.
+	std::shared_ptr<const string> source;
+	source.swap(_deferred);
+	control& ctrl=const_cast<control&>(*this);
+	control_cursor cursor(source->begin()+_deferred_first,
+		source->begin()+_deferred_last);
+	if (cursor.next_record())
+	{
+		while (cursor.next_field())
+		{
+			if (deferred(cursor.field()))
+				ctrl[cursor.name()]=cursor.value();
+		}
+	}
+}
+
+void control::write_deferred(std::ostream& out) const
+{
+	for (const_iterator i=_data.begin();i!=_data.end();++i)
+	{
+		if (deferred(i->first._field))
+			write_field(out,i->first,i->second);
+	}
+
+	// Fields which have not been decoded are copied as they are.  If
+	// any have the same name as a field written above then they will
+	// take precedence when read back, just as they would if decoded.
+	if (!_deferred) return;
+	control_cursor cursor(_deferred->begin()+_deferred_first,
+		_deferred->begin()+_deferred_last);
+	if (cursor.next_record())
+	{
+		while (cursor.next_field())
+		{
+			if (deferred(cursor.field()))
+			{
+				out.write(&*cursor.field_begin(),
+					cursor.field_end()-cursor.field_begin());
+				out << '\n';
+			}
+		}
+	}
+}
+
+void control::write(std::ostream& out) const
+{
+	if (!_deferred)
+	{
+		for (const_iterator i=_data.begin();i!=_data.end();++i)
+			write_field(out,i->first,i->second);
+		return;
+	}
+
+	// Sort the fields which have not been decoded into the order in
+	// which they would appear in the map once decoded.  None of them can
+	// also be present in the map, because adding a field decodes them.
+	typedef std::pair<string::const_iterator,string::const_iterator> text;
+	std::map<key_type,text,cmp_key> undecoded;
+	control_cursor cursor(_deferred->begin()+_deferred_first,
+		_deferred->begin()+_deferred_last);
+	if (cursor.next_record())
+	{
+		while (cursor.next_field())
+		{
+			if (deferred(cursor.field()))
+			{
+				key_type key(cursor.name());
+				key._priority=priority(to_lower(key));
+				undecoded[key]=text(cursor.field_begin(),cursor.field_end());
+			}
+		}
+	}
+
+	// Merge them with the decoded fields.
+	cmp_key cmp;
+	const_iterator i=_data.begin();
+	for (std::map<key_type,text,cmp_key>::const_iterator j=undecoded.begin();
+		j!=undecoded.end();++j)
+	{
+		for (;(i!=_data.end())&&cmp(i->first,j->first);++i)
+			write_field(out,i->first,i->second);
+		out.write(&*j->second.first,j->second.second-j->second.first);
+		out << '\n';
+	}
+	for (;i!=_data.end();++i)
+		write_field(out,i->first,i->second);
+}
+
+void control::index_fields()
+{
+	for (unsigned int i=0;i!=field_count;++i)
+		_fields[i]=_data.end();
+	for (iterator i=_data.begin();i!=_data.end();++i)
+	{
+		if (i->first._field!=field_count)
+			_fields[i->first._field]=i;
+	}
+}
+
+string control::field_value(field_type field) const
+{
+	const_iterator f=find(field);
+	return (f==end())?string():(*f).second.str();
 }
 
 string control::pkgname() const
 {
-	static const key_type key("Package");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_package);
 }
 
 string control::version() const
 {
-	static const key_type key("Version");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_version);
 }
 
 string control::standards_version() const
 {
-	static const key_type key("Standards-Version");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_standards_version);
 }
 
 string control::depends() const
 {
-	static const key_type key("Depends");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_depends);
 }
 
 string control::recommends() const
 {
-	static const key_type key("Recommends");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_recommends);
 }
 
 string control::suggests() const
 {
-	static const key_type key("Suggests");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_suggests);
 }
 
 string control::conflicts() const
 {
-	static const key_type key("Conflicts");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_conflicts);
 }
 
 string control::description() const
 {
-	static const key_type key("Description");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_description);
 }
 
 string control::short_description() const
@@ -120,32 +400,38 @@ string control::short_description() const
 
 string control::url() const
 {
-	static const key_type key("URL");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_url);
 }
 
 string control::components() const
 {
-	static const key_type key("Components");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_components);
 }
 
-
 string control::environment() const
 {
-	static const key_type key("Environment");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
-
+	return field_value(field_environment);
 }
 
 string control::osdepends() const
 {
-	static const key_type key("OSDepends");
-	const_iterator f=find(key);
-	return (f==end())?string():(*f).second;
+	return field_value(field_osdepends);
+}
+
+control::field_type control::find_field(const char* name,
+	string::size_type length)
+{
+	if (!length) return field_count;
+	field_type field=field_slots[field_hash(name,length)];
+	if (field==field_count) return field_count;
+	const char* fname=field_names[field];
+	for (string::size_type i=0;i!=length;++i)
+	{
+		char ch=fname[i];
+		if ((ch==0)||(tolower(static_cast<unsigned char>(name[i]))!=ch))
+			return field_count;
+	}
+	return (fname[length]==0)?field:field_count;
 }
 
 int control::priority(const string& value) const
@@ -155,12 +441,14 @@ int control::priority(const string& value) const
 
 control::key_type::key_type(const string& value):
 	string(value),
-	_priority(0)
+	_priority(0),
+	_field(find_field(data(),length()))
 {}
 
 control::key_type::key_type(const char* value):
 	string(value),
-	_priority(0)
+	_priority(0),
+	_field(find_field(data(),length()))
 {}
 
 bool control::cmp_key::operator()(const key_type& lhs,
@@ -181,102 +469,85 @@ control::parse_error::parse_error(const char* message):
 
 std::ostream& operator<<(std::ostream& out,const control& ctrl)
 {
-	for (control::const_iterator ci=ctrl.begin();ci!=ctrl.end();++ci)
-	{
-		out << (*ci).first << ':';
-		std::string value((*ci).second);
-		unsigned int i=0;
-		unsigned int f=value.find('\n',i);
-		while (f!=std::string::npos)
-		{
-			if ((f==i)&&(i!=0))
-				out << " ." << std::endl;
-			else
-				out << ' ' << value.substr(i,f-i) << std::endl;
-			i=f+1;
-			f=value.find('\n',i);
-		}
-		if ((value.length()==i)&&(i!=0))
-			out << " ." << std::endl;
-		else
-			out << ' ' << value.substr(i) << std::endl;
-	}
+	ctrl.write(out);
 	return out;
 }
 
 std::istream& operator>>(std::istream& in,control& ctrl)
 {
-	string* field=0;
+	// Read lines up to and including the first blank line.
+	string record;
 	bool done=false;
 	while (in&&!done)
 	{
-		// Get line from input stream.
 		string line;
 		getline(in,line);
+		record+=line;
+		record+='\n';
 
-		// Convert to sequence.
-		string::const_iterator first=line.begin();
-		string::const_iterator last=line.end();
-
-		// Strip trailing spaces.
-		while ((last!=first)&&isspace(*(last-1))) --last;
+		// Line is blank if it contains nothing but spaces.
+		string::const_iterator p=line.begin();
+		while ((p!=line.end())&&isspace(*p)) ++p;
+		done=(p==line.end());
+	}
+	parse_control(record.begin(),record.end(),ctrl);
+	return in;
+}
 
-		if ((first==last)||isspace(*first))
+string::const_iterator parse_control(string::const_iterator first,
+	string::const_iterator last,control& ctrl)
+{
+	control_cursor cursor(first,last);
+	if (cursor.next_record())
+	{
+		while (cursor.next_field())
 		{
-			// Line is blank or begins with a space:
-			// Skip leading spaces.
-			string::const_iterator p=first;
-			while ((p!=last)&&isspace(*p)) ++p;
-			if (p==last)
-			{
-				// Line is blank (or contains only spaces):
-				done=true;
-			}
-			else
-			{
-				// Line is a continuation line:
-				// Check whether there is a field to continue.
-				if (!field)
-					throw control::parse_error(
-						"continuation line not allowed here");
-
-				// If line contains nothing but a period
-				// then skip that character.
-				if ((p+1==last)&&(*p=='.')) ++p;
-
-				// Append continuation line to field.
-				*field+=string("\n");
-				*field+=string(p,last);
-			}
+			// Store field name and value.
+			control::key_type fieldname(cursor.name());
+			if (ctrl.find(fieldname)!=ctrl.end())
+				throw control::parse_error("duplicate field name");
+			ctrl[fieldname]=cursor.value();
 		}
-		else
+	}
+	return cursor.next();
+}
+
+string::size_type parse_control(const std::shared_ptr<const string>& source,
+	string::size_type first,string::size_type last,control& ctrl,
+	string_pool* pool)
+{
+	control_cursor cursor(source->begin()+first,source->begin()+last);
+	if (cursor.next_record())
+	{
+		// Deferred fields are not in the control file, so duplicates are
+		// found by recording the name of every field.  As in the control
+		// file itself, only standard field names are compared without
+		// regard to case.
+		field_name_set names;
+		bool any_deferred=false;
+		while (cursor.next_field())
 		{
-			// Line does not begin with a space:
-			// Parse fieldname.
-			string::const_iterator p=first;
-			while ((p!=last)&&(*p!=':'))
+			if (!names.insert(cursor))
+				throw control::parse_error("duplicate field name");
+			if (control::deferred(cursor.field()))
 			{
-				if (isspace(*p))
-					throw control::parse_error("syntax error");
-				++p;
+				any_deferred=true;
+				continue;
 			}
-			string fieldname=string(first,p);
-			if (ctrl.find(fieldname)!=ctrl.end())
-				throw control::parse_error("duplicate field name");
-
-			// Parse colon at end of fieldname.
-			if ((p!=last)&&(*p==':')) ++p;
-			else throw control::parse_error("':' expected");
-
-			// Skip spaces.
-			while ((p!=last)&&isspace(*p)) ++p;
 
-			// Store field name and value
-			field=&ctrl[fieldname];
-			*field=string(p,last);
+			// Store field name and value.
+			control::mapped_type& value=
+				ctrl[control::key_type(cursor.name())];
+			if (pool) value=pool->intern(cursor.value());
+			else value=cursor.value();
+		}
+		if (any_deferred)
+		{
+			ctrl.defer(source,cursor.record_begin()-source->begin(),
+				cursor.record_end()-source->begin());
 		}
 	}
-	return in;
+	return cursor.next()-source->begin();
 }
 
 }; /* namespace pkg */
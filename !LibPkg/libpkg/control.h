@@ -18,14 +18,19 @@
 #define LIBPKG_CONTROL
 
 #include <map>
+#include <memory>
 #include <string>
 #include <iosfwd>
 #include <stdexcept>
 
+#include "libpkg/shared_string.h"
+
 namespace pkg {
 
 using std::string;
 
+class string_pool;
+
 /** A class to represent the content of a RiscPkg control file.
  * Behaviour is that of a map<string,string>, except that:
  * - key comparison is case-insensitive;
@@ -35,6 +40,38 @@ using std::string;
 class control
 {
 public:
+	/** An enumeration of the standard field names.
+	 * Fields with these names are held in fixed slots, so that they can
+	 * be found without comparing strings or allocating memory.
+	 */
+	enum field_type
+	{
+		field_package,
+		field_version,
+		field_standards_version,
+		field_description,
+		field_depends,
+		field_recommends,
+		field_suggests,
+		field_conflicts,
+		field_url,
+		field_components,
+		field_environment,
+		field_osdepends,
+		field_md5sum,
+		field_size,
+		field_source,
+		field_maintainer,
+		field_installed_size,
+		field_section,
+		field_priority,
+		field_installpriority,
+		field_licence,
+		/** The number of standard fields.
+		 * This value is also used to indicate a non-standard field. */
+		field_count
+	};
+
 	/** The key type.
 	 * This is a std::string, augmented to include a priority.
 	 *
@@ -50,6 +87,9 @@ public:
 	private:
 		/** The priority. */
 		int _priority;
+
+		/** The standard field name, or field_count if none. */
+		field_type _field;
 	public:
 		/** Construct key from string.
 		 * @param value the key value
@@ -66,10 +106,20 @@ public:
 		 */
 		int priority() const
 			{ return _priority; }
+
+		/** Get standard field name.
+		 * @return the standard field name, or field_count if this key
+		 *  is not a standard field name
+		 */
+		field_type field() const
+			{ return _field; }
 	};
 
-	/** The mapped type. */
-	typedef string mapped_type;
+	/** The mapped type.
+	 * Values are held as shared strings, so that records can share
+	 * the storage of repeated values.
+	 */
+	typedef shared_string mapped_type;
 
 	/** The value type. */
 	typedef std::pair<const key_type,mapped_type> value_type;
@@ -99,18 +149,43 @@ private:
 
 	/** A map from key to value. */
 	std::map<key_type,mapped_type,cmp_key> _data;
+
+	/** The location of each standard field within the map,
+	 * or _data.end() if the field is not present. */
+	iterator _fields[field_count];
+
+	/** The buffer containing any fields that have not yet been decoded,
+	 * or null if there are none. */
+	mutable std::shared_ptr<const string> _deferred;
+
+	/** The offset of the first undecoded field within the buffer. */
+	mutable string::size_type _deferred_first;
+
+	/** The offset of the end of the last undecoded field. */
+	mutable string::size_type _deferred_last;
 public:
 	/** Construct control file. */
 	control();
 
+	/** Copy control file.
+	 * @param ctrl the control file to be copied
+	 */
+	control(const control& ctrl);
+
 	/** Destroy control file. */
 	virtual ~control();
 
+	/** Assign control file.
+	 * @param ctrl the control file to be copied
+	 * @return a reference to this control file
+	 */
+	control& operator=(const control& ctrl);
+
 	/** Get constant iterator for beginning of control file.
 	 * @return the beginning of the control file
 	 */
 	const_iterator begin() const
-		{ return _data.begin(); }
+		{ decode(); return _data.begin(); }
 
 	/** Get constant iterator for end of control file.
 	 * @return the end of the control file
@@ -122,13 +197,20 @@ public:
 	 * @param key the key to be found
 	 * @return the field matching the key if there is one, otherwise end().
 	 */
-	const_iterator find(key_type key) const;
+	const_iterator find(const key_type& key) const;
+
+	/** Find constant iterator for standard field.
+	 * @param field the standard field name
+	 * @return the field if it is present, otherwise end().
+	 */
+	const_iterator find(field_type field) const
+		{ if (deferred(field)) decode(); return _fields[field]; }
 
 	/** Get iterator for beginning of control file.
 	 * @return the beginning of the control file
 	 */
 	iterator begin()
-		{ return _data.begin(); }
+		{ decode(); return _data.begin(); }
 
 	/** Get iterator for end of control file.
 	 * @return the end of the control file
@@ -140,7 +222,14 @@ public:
 	 * @param key the key to be found
 	 * @return the field matching the key if there is one, otherwise end().
 	 */
-	iterator find(key_type key);
+	iterator find(const key_type& key);
+
+	/** Find iterator for standard field.
+	 * @param field the standard field name
+	 * @return the field if it is present, otherwise end().
+	 */
+	iterator find(field_type field)
+		{ if (deferred(field)) decode(); return _fields[field]; }
 
 	/** Get value corresponding to given key.
 	 * If the key does not exist within the control file then it is created.
@@ -150,13 +239,61 @@ public:
 	 * @param key the key
 	 * @return a reference to the value
 	 */
-	mapped_type& operator[](key_type key);
+	mapped_type& operator[](const key_type& key);
 
 	/** Clear control file.
 	 * All keys and values are deleted.
 	 */
 	void clear();
 
+	/** Test whether control file is empty.
+	 * This does not cause any deferred fields to be decoded.
+	 * @return true if there are no fields, otherwise false
+	 */
+	bool empty() const
+		{ return _data.empty()&&!_deferred; }
+
+	/** Defer decoding of fields.
+	 * The given range of the buffer must contain a sequence of fields
+	 * in control file format.  Those fields which are not decoded
+	 * immediately (the description and any non-standard fields) are
+	 * decoded from the buffer when first needed, and any other fields
+	 * in the range are ignored.  The control file holds a reference
+	 * to the buffer until then.
+	 * @param source the buffer
+	 * @param first the offset of the beginning of the range
+	 * @param last the offset of the end of the range
+	 */
+	void defer(const std::shared_ptr<const string>& source,
+		string::size_type first,string::size_type last);
+
+	/** Test whether a field is one which may be decoded on demand.
+	 * Descriptions make up the bulk of a package index, but are
+	 * rarely needed, so are not decoded until they are accessed.
+	 * @param field the standard field name, or field_count for a
+	 *  non-standard field
+	 * @return true if decoding of the field may be deferred
+	 */
+	static bool deferred(field_type field)
+		{ return (field==field_description)||(field==field_count); }
+
+	/** Write the fields for which decoding may be deferred.
+	 * The fields are written in control file format.  Any that have not
+	 * yet been decoded are copied directly from the buffer, so this does
+	 * not cause them to be decoded.
+	 * @param out the output stream
+	 */
+	void write_deferred(std::ostream& out) const;
+
+	/** Write the control file.
+	 * The fields are written in control file format, in the same order
+	 * as they would be visited by an iterator.  Any that have not yet
+	 * been decoded are copied directly from the buffer, so this does not
+	 * cause them to be decoded.
+	 * @param out the output stream
+	 */
+	void write(std::ostream& out) const;
+
 	/** Get number of fields.
 	 * @return the number of fields
 	 */
@@ -239,6 +376,15 @@ public:
 	 */
 	string osdepends() const;
 
+	/** Identify standard field name.
+	 * The comparison is case-insensitive.  It uses a perfect hash of
+	 * the standard field names, so does not allocate any memory.
+	 * @param name the field name
+	 * @param length the length of the field name
+	 * @return the standard field name, or field_count if none
+	 */
+	static field_type find_field(const char* name,string::size_type length);
+
 protected:
 	/** Get priority.
 	 * This function may be overridden to modify the sort order.
@@ -251,6 +397,18 @@ protected:
 	 * @return the priority
 	 */
 	virtual int priority(const string& value) const;
+private:
+	/** Rebuild the table of standard field locations. */
+	void index_fields();
+
+	/** Decode any fields for which decoding has been deferred. */
+	void decode() const;
+
+	/** Get value of standard field.
+	 * @param field the standard field name
+	 * @return the value if the field is present, otherwise the empty string
+	 */
+	string field_value(field_type field) const;
 };
 
 /** An exception class for reporting parse errors. */
@@ -278,6 +436,37 @@ std::ostream& operator<<(std::ostream& out,const control& ctrl);
  */
 std::istream& operator>>(std::istream& in,control& ctrl);
 
+/** Parse control file from character sequence.
+ * Parsing stops after the first blank line, so a sequence containing
+ * several control records (such as a package index) can be read by
+ * calling this function repeatedly.  Any blank lines before the record
+ * are skipped.  Field values are copied directly from the sequence,
+ * without first splitting it into lines.
+ * @param first the beginning of the sequence
+ * @param last the end of the sequence
+ * @param ctrl the control file
+ * @return the beginning of the remainder of the sequence
+ */
+string::const_iterator parse_control(string::const_iterator first,
+	string::const_iterator last,control& ctrl);
+
+/** Parse control file from shared buffer.
+ * This behaves in the same way as the version of parse_control which
+ * takes a pair of iterators, except that decoding of the description
+ * and any non-standard fields is deferred until they are accessed.
+ * Syntax errors and duplicate fields are reported immediately.
+ * @param source the buffer
+ * @param first the offset at which to begin parsing
+ * @param last the offset at which to stop parsing
+ * @param ctrl the control file
+ * @param pool the pool in which to intern the values of the fields that
+ *  are decoded, or 0 if they are not to be interned
+ * @return the offset of the remainder of the buffer
+ */
+string::size_type parse_control(const std::shared_ptr<const string>& source,
+	string::size_type first,string::size_type last,control& ctrl,
+	string_pool* pool=0);
+
 }; /* namespace pkg */
 
 #endif
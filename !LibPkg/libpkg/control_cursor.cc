@@ -0,0 +1,287 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <stdint.h>
+#include <ctype.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "libpkg/control_cursor.h"
+
+namespace pkg {
+
+const char* find_char(const char* first,const char* last,char ch)
+{
+#if defined(__AVX2__)
+	const __m256i pattern256=_mm256_set1_epi8(ch);
+	while (last-first>=32)
+	{
+		__m256i block=_mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(first));
+		unsigned int mask=_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(block,pattern256));
+		if (mask) return first+__builtin_ctz(mask);
+		first+=32;
+	}
+#endif
+#if defined(__SSE2__)
+	const __m128i pattern128=_mm_set1_epi8(ch);
+	while (last-first>=16)
+	{
+		__m128i block=_mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(first));
+		unsigned int mask=_mm_movemask_epi8(
+			_mm_cmpeq_epi8(block,pattern128));
+		if (mask) return first+__builtin_ctz(mask);
+		first+=16;
+	}
+#endif
+	return find_char_scalar(first,last,ch);
+}
+
+const char* find_char_scalar(const char* first,const char* last,char ch)
+{
+	// Align to a word boundary.
+	typedef unsigned long word;
+	while ((first!=last)&&(reinterpret_cast<uintptr_t>(first)%sizeof(word)))
+	{
+		if (*first==ch) return first;
+		++first;
+	}
+
+	// Search a word at a time.  A word contains the character if the
+	// result of exclusive-oring it with the pattern contains a zero byte.
+	const word ones=~word(0)/0xff;
+	const word highs=ones*0x80;
+	const word pattern=ones*static_cast<unsigned char>(ch);
+	while (static_cast<size_t>(last-first)>=sizeof(word))
+	{
+		word w;
+		std::memcpy(&w,first,sizeof(word));
+		w^=pattern;
+		if ((w-ones)&~w&highs) break;
+		first+=sizeof(word);
+	}
+
+	// Search remainder a byte at a time.
+	while ((first!=last)&&(*first!=ch)) ++first;
+	return first;
+}
+
+namespace {
+
+/** Find the end of a line.
+ * @param first the beginning of the line
+ * @param last the end of the sequence
+ * @return the position of the newline, or last if there is none
+ */
+inline string::const_iterator find_eol(string::const_iterator first,
+	string::const_iterator last)
+{
+	if (first==last) return last;
+	const char* p=&*first;
+	return first+(find_char(p,p+(last-first),'\n')-p);
+}
+
+/** Strip trailing spaces from a line.
+ * @param first the beginning of the line
+ * @param last the end of the line
+ * @return the end of the line, excluding trailing spaces
+ */
+inline string::const_iterator strip(string::const_iterator first,
+	string::const_iterator last)
+{
+	while ((last!=first)&&isspace(*(last-1))) --last;
+	return last;
+}
+
+/** Test whether a line is blank.
+ * @param first the beginning of the line
+ * @param last the end of the line
+ * @return true if the line contains nothing but spaces, otherwise false
+ */
+inline bool is_blank(string::const_iterator first,
+	string::const_iterator last)
+{
+	while ((first!=last)&&isspace(*first)) ++first;
+	return first==last;
+}
+
+}; /* anonymous namespace */
+
+control_cursor::control_cursor(string::const_iterator first,
+	string::const_iterator last):
+	_last(last),
+	_next(first),
+	_record_first(first),
+	_record_last(first),
+	_record_stop(first),
+	_pos(first),
+	_field_first(first),
+	_name_last(first),
+	_value_first(first),
+	_value_last(first),
+	_field(control::field_count)
+{}
+
+bool control_cursor::next_record()
+{
+	// Skip blank lines.
+	string::const_iterator p=_next;
+	while (p!=_last)
+	{
+		string::const_iterator q=find_eol(p,_last);
+		if (!is_blank(p,q)) break;
+		p=(q!=_last)?q+1:_last;
+	}
+	_record_first=p;
+	_record_last=p;
+	_pos=p;
+
+	// Find the blank line (or end of sequence) that terminates the record.
+	// Only lines that begin with a space need to be examined in full.
+	while (p!=_last)
+	{
+		string::const_iterator q=find_eol(p,_last);
+		if (q==_last) break;
+		p=q+1;
+		if ((p!=_last)&&isspace(*p))
+		{
+			q=find_eol(p,_last);
+			if (is_blank(p,q))
+			{
+				_record_stop=p;
+				_record_last=strip(_record_first,_record_stop);
+				_next=(q!=_last)?q+1:_last;
+				return true;
+			}
+		}
+	}
+	_record_stop=_last;
+	_record_last=strip(_record_first,_record_stop);
+	_next=_last;
+	return _record_first!=_last;
+}
+
+bool control_cursor::next_field()
+{
+	if (_pos==_record_stop) return false;
+
+	// Read first line of field.
+	string::const_iterator first=_pos;
+	string::const_iterator q=find_eol(first,_record_stop);
+	string::const_iterator last=strip(first,q);
+	_pos=(q!=_record_stop)?q+1:_record_stop;
+
+	// The record does not contain any blank lines, so a line that
+	// begins with a space must be a continuation line.
+	if (isspace(*first))
+		throw control::parse_error("continuation line not allowed here");
+
+	// Parse fieldname.
+	string::const_iterator p=first;
+	while ((p!=last)&&(*p!=':'))
+	{
+		if (isspace(*p))
+			throw control::parse_error("syntax error");
+		++p;
+	}
+	_field_first=first;
+	_name_last=p;
+	_field=control::find_field(&*first,p-first);
+
+	// Parse colon at end of fieldname.
+	if ((p!=last)&&(*p==':')) ++p;
+	else throw control::parse_error("':' expected");
+
+	// Skip spaces.
+	while ((p!=last)&&isspace(*p)) ++p;
+	_value_first=p;
+	_value_last=last;
+
+	// Absorb continuation lines.
+	while ((_pos!=_record_stop)&&isspace(*_pos))
+	{
+		q=find_eol(_pos,_record_stop);
+		_value_last=strip(_pos,q);
+		_pos=(q!=_record_stop)?q+1:_record_stop;
+	}
+	return true;
+}
+
+string control_cursor::value() const
+{
+	// Copy first line.
+	string::const_iterator q=find_eol(_value_first,_value_last);
+	string result(_value_first,strip(_value_first,q));
+
+	// Append continuation lines.
+	while (q!=_value_last)
+	{
+		string::const_iterator p=q+1;
+		q=find_eol(p,_value_last);
+		string::const_iterator last=strip(p,q);
+		while ((p!=last)&&isspace(*p)) ++p;
+
+		// If line contains nothing but a period
+		// then skip that character.
+		if ((p+1==last)&&(*p=='.')) ++p;
+
+		result.push_back('\n');
+		result.append(p,last);
+	}
+	return result;
+}
+
+field_name_set::field_name_set()
+{
+	clear();
+}
+
+void field_name_set::clear()
+{
+	for (unsigned int i=0;i!=control::field_count;++i)
+		_standard[i]=false;
+	_others.clear();
+}
+
+bool field_name_set::insert(const control_cursor& cursor)
+{
+	control::field_type field=cursor.field();
+	if (field!=control::field_count)
+	{
+		if (_standard[field]) return false;
+		_standard[field]=true;
+		return true;
+	}
+
+	string name=cursor.name();
+	for (std::vector<string>::const_iterator i=_others.begin();
+		i!=_others.end();++i)
+	{
+		if (*i==name) return false;
+	}
+	_others.push_back(name);
+	return true;
+}
+
+}; /* namespace pkg */
@@ -0,0 +1,241 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_CONTROL_CURSOR
+#define LIBPKG_CONTROL_CURSOR
+
+#include <string>
+#include <vector>
+
+#include "libpkg/control.h"
+
+namespace pkg {
+
+using std::string;
+
+/** A class for reading control records one field at a time.
+ * The cursor works directly on a character sequence (typically the
+ * content of a package index held in memory).  It does not build a
+ * control object, so the only memory it allocates is for values that
+ * the caller explicitly asks to be decoded.
+ *
+ * Typical use is:
+ * @code
+ * control_cursor cursor(buffer.begin(),buffer.end());
+ * while (cursor.next_record())
+ * {
+ *     while (cursor.next_field())
+ *     {
+ *         if (cursor.field()==control::field_version) ...
+ *     }
+ * }
+ * @endcode
+ *
+ * Field names, values and whole fields are exposed as ranges within
+ * the underlying sequence, which allows a record to be copied to an
+ * output stream with one or more of its fields rewritten.  Syntax
+ * errors are reported by throwing a control::parse_error.
+ */
+class control_cursor
+{
+private:
+	/** The end of the sequence. */
+	string::const_iterator _last;
+
+	/** The position from which to search for the next record. */
+	string::const_iterator _next;
+
+	/** The beginning of the current record. */
+	string::const_iterator _record_first;
+
+	/** The end of the content of the current record. */
+	string::const_iterator _record_last;
+
+	/** The end of the lines belonging to the current record. */
+	string::const_iterator _record_stop;
+
+	/** The position from which to read the next field. */
+	string::const_iterator _pos;
+
+	/** The beginning of the current field. */
+	string::const_iterator _field_first;
+
+	/** The end of the name of the current field. */
+	string::const_iterator _name_last;
+
+	/** The beginning of the value of the current field. */
+	string::const_iterator _value_first;
+
+	/** The end of the value of the current field. */
+	string::const_iterator _value_last;
+
+	/** The standard field name of the current field. */
+	control::field_type _field;
+public:
+	/** Construct control cursor.
+	 * @param first the beginning of the sequence
+	 * @param last the end of the sequence
+	 */
+	control_cursor(string::const_iterator first,string::const_iterator last);
+
+	/** Advance to the next record.
+	 * Blank lines before the record are skipped.
+	 * @return true if there is a record, false if the end of the
+	 *  sequence has been reached
+	 */
+	bool next_record();
+
+	/** Advance to the next field of the current record.
+	 * @return true if there is a field, false if the end of the
+	 *  record has been reached
+	 */
+	bool next_field();
+
+	/** Get the position following the current record.
+	 * This is after the blank line (if any) that terminates the record.
+	 * @return the position following the current record
+	 */
+	string::const_iterator next() const
+		{ return _next; }
+
+	/** Get the beginning of the current record.
+	 * @return the beginning of the record
+	 */
+	string::const_iterator record_begin() const
+		{ return _record_first; }
+
+	/** Get the end of the current record.
+	 * This excludes the newline at the end of the final line.
+	 * @return the end of the record
+	 */
+	string::const_iterator record_end() const
+		{ return _record_last; }
+
+	/** Get the beginning of the current field.
+	 * @return the beginning of the field name
+	 */
+	string::const_iterator field_begin() const
+		{ return _field_first; }
+
+	/** Get the end of the current field.
+	 * This includes any continuation lines, but excludes the newline
+	 * at the end of the final line.
+	 * @return the end of the field
+	 */
+	string::const_iterator field_end() const
+		{ return _value_last; }
+
+	/** Get the end of the name of the current field.
+	 * The beginning of the name is given by field_begin().
+	 * @return the end of the field name
+	 */
+	string::const_iterator name_end() const
+		{ return _name_last; }
+
+	/** Get the beginning of the value of the current field.
+	 * @return the beginning of the undecoded value
+	 */
+	string::const_iterator value_begin() const
+		{ return _value_first; }
+
+	/** Get the end of the value of the current field.
+	 * For a field without continuation lines the range from
+	 * value_begin() to value_end() is identical to the decoded value.
+	 * @return the end of the undecoded value
+	 */
+	string::const_iterator value_end() const
+		{ return _value_last; }
+
+	/** Get the standard field name of the current field.
+	 * @return the standard field name, or control::field_count if the
+	 *  field is not a standard one
+	 */
+	control::field_type field() const
+		{ return _field; }
+
+	/** Get the name of the current field.
+	 * @return the field name
+	 */
+	string name() const
+		{ return string(_field_first,_name_last); }
+
+	/** Decode the value of the current field.
+	 * Continuation lines are joined with newlines, and a continuation
+	 * line containing only a period is decoded as an empty line,
+	 * giving the same result as reading the field into a control object.
+	 * @return the decoded value
+	 */
+	string value() const;
+};
+
+/** A class for detecting duplicate field names within a control record.
+ * Standard field names are compared without regard to case, as they
+ * are by control::find(), and other field names are compared exactly,
+ * as they are by control::cmp_key.  This allows a record read using a
+ * control_cursor to be checked in the same way as parse_control() would
+ * check it, without building a control object.
+ */
+class field_name_set
+{
+private:
+	/** True for each standard field that has been added. */
+	bool _standard[control::field_count];
+
+	/** The names of the non-standard fields that have been added. */
+	std::vector<string> _others;
+public:
+	/** Construct empty field name set. */
+	field_name_set();
+
+	/** Remove all field names from the set. */
+	void clear();
+
+	/** Add the name of the current field of a cursor.
+	 * @param cursor the cursor
+	 * @return true if the name was added, false if a field with the
+	 *  same name had already been added
+	 */
+	bool insert(const control_cursor& cursor);
+};
+
+/** Find the first occurrence of a character.
+ * This is the search used by control_cursor to find the end of each
+ * line.  The sequence is searched in blocks of 32 bytes when AVX2 is
+ * available, 16 bytes when SSE2 is available, and otherwise as by
+ * find_char_scalar().
+ * @param first the beginning of the sequence
+ * @param last the end of the sequence
+ * @param ch the character to be found
+ * @return the position of the character, or last if there is none
+ */
+const char* find_char(const char* first,const char* last,char ch);
+
+/** Find the first occurrence of a character without using vector
+ * instructions.
+ * The sequence is searched one machine word at a time, and any
+ * remainder a byte at a time.  This is the fallback used by find_char()
+ * when no vector instructions are available.
+ * @param first the beginning of the sequence
+ * @param last the end of the sequence
+ * @param ch the character to be found
+ * @return the position of the character, or last if there is none
+ */
+const char* find_char_scalar(const char* first,const char* last,char ch);
+
+}; /* namespace pkg */
+
+#endif
@@ -0,0 +1,62 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libpkg/dependency_cache.h"
+
+namespace pkg {
+
+dependency_cache::dependency_cache(table& t):
+	_hits(0),
+	_misses(0)
+{
+	watch(t);
+}
+
+dependency_cache::~dependency_cache()
+{}
+
+const dependency_cache::list_type& dependency_cache::operator[](
+	const string& deplist)
+{
+	std::unordered_map<string,list_type>::iterator f=_data.find(deplist);
+	if (f!=_data.end())
+	{
+		++_hits;
+		return f->second;
+	}
+
+	// Parse into a local list first, so that nothing is cached if
+	// the dependency list is invalid.
+	++_misses;
+	list_type deps;
+	parse_dependency_list(deplist.begin(),deplist.end(),&deps);
+	list_type& result=_data[deplist];
+	result.swap(deps);
+	return result;
+}
+
+void dependency_cache::clear()
+{
+	_data.clear();
+}
+
+void dependency_cache::handle_change(table& t)
+{
+	clear();
+}
+
+}; /* namespace pkg */
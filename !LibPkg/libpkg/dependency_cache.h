@@ -0,0 +1,97 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_DEPENDENCY_CACHE
+#define LIBPKG_DEPENDENCY_CACHE
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "libpkg/dependency.h"
+#include "libpkg/table.h"
+
+namespace pkg {
+
+using std::string;
+
+/** A class for caching parsed dependency lists.
+ * Dependency lists are keyed by the text from which they were parsed,
+ * so control records with identical Depends fields (which share storage
+ * once interned by the binary control table) share one parsed list.
+ * The cache is emptied whenever the table that it watches changes.
+ */
+class dependency_cache:
+	private table::watcher
+{
+public:
+	/** The type of a parsed dependency list. */
+	typedef std::vector<std::vector<dependency> > list_type;
+private:
+	/** A map from dependency list text to parsed dependency list. */
+	std::unordered_map<string,list_type> _data;
+
+	/** The number of lookups that found a parsed list. */
+	unsigned long _hits;
+
+	/** The number of lookups that needed a list to be parsed. */
+	unsigned long _misses;
+public:
+	/** Construct dependency cache.
+	 * @param t the table from which dependency lists are taken
+	 */
+	dependency_cache(table& t);
+
+	/** Destroy dependency cache. */
+	virtual ~dependency_cache();
+
+	/** Get parsed dependency list.
+	 * The list is parsed if it is not already in the cache.  The
+	 * reference remains valid until the watched table changes or the
+	 * cache is cleared.
+	 * @param deplist the dependency list text
+	 * @return the parsed dependency list
+	 */
+	const list_type& operator[](const string& deplist);
+
+	/** Remove all parsed dependency lists from the cache. */
+	void clear();
+
+	/** Get number of parsed dependency lists held by the cache.
+	 * @return the number of lists
+	 */
+	unsigned int size() const
+		{ return _data.size(); }
+
+	/** Get number of lookups that found a parsed list.
+	 * @return the number of hits
+	 */
+	unsigned long hits() const
+		{ return _hits; }
+
+	/** Get number of lookups that needed a list to be parsed.
+	 * @return the number of misses
+	 */
+	unsigned long misses() const
+		{ return _misses; }
+private:
+	virtual void handle_change(table& t);
+};
+
+}; /* namespace pkg */
+
+#endif
@@ -116,6 +116,9 @@ public:
 	/** Main type to describe this package, chosen from the checks in the environment */
 	env_check_type type() const {return _type;}
 
+	/** The checks that must all be available for this environment */
+	const std::vector<env_check *> &checks() const {return _checks;}
+
 	/** Reset available flag from contained checks */
 	void reset_available();
 
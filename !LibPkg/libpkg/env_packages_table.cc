@@ -66,6 +66,19 @@ void env_packages_table::handle_change(table& t)
 	rebuild();
 }
 
+/**
+ * Packages in the binary control table have changed, so update
+ * only the best versions of those packages
+ */
+void env_packages_table::handle_change(table& t,const std::set<std::string>& keys)
+{
+	batch b(*this);
+	for (auto &pkgname : keys)
+	{
+		if (update_best(pkgname)) notify(pkgname);
+	}
+}
+
 /**
  * Environment has changed so build
  */
@@ -83,38 +96,64 @@ void env_packages_table::rebuild()
 
 	_data.clear();
 
-	for (auto &bcentry : *_control)
+	for (auto bcentry = _control->begin(); bcentry != _control->end(); )
 	{
-		const binary_control &bctrl = bcentry.second;
+		const std::string &pkgname = bcentry->first.pkgname;
+		update_best(pkgname);
+		bcentry = _control->equal_range(pkgname).second;
+	}
+	notify();
+}
+
+/**
+ * Find the best package for one package name from its records
+ * in the binary control table
+ */
+bool env_packages_table::update_best(const std::string &pkgname)
+{
+	const binary_control_table::record_list &records = _control->records(pkgname);
+	binary_control_table::const_iterator found = _control->end();
+	for (auto &bcentry : records)
+	{
+		const binary_control &bctrl = bcentry->second;
 		if (bctrl.package_env()->available())
 		{
-			std::map<key_type,mapped_type>::iterator found = _data.find(bcentry.first.pkgname);
-			version new_version(bctrl.version());
-			if (found == _data.end())
+			if (found == _control->end()
+				|| bcentry->first.pkgvrsn > found->first.pkgvrsn)
 			{
-				best b(new_version, bctrl.environment_id());
-				// New package name
-				_data.insert(std::make_pair(bcentry.first.pkgname, b));
-			} else
+				// New package name or found a better version
+				found = bcentry;
+			} else if (bcentry->first.pkgvrsn == found->first.pkgvrsn)
 			{
-				if (new_version > found->second.pkgvrsn)
-				{
-					// found a better version
-					found->second = best(new_version, bctrl.environment_id());
-				} else if (new_version == found->second.pkgvrsn)
+				// Versions the same check the weights
+				if (bctrl.install_priority() > found->second.install_priority())
 				{
-					// Versions the same check the weights
-					binary_control_table::key_type key(bcentry.first.pkgname, found->second.pkgvrsn, found->second.pkgenv);
-					const binary_control &pctrl = (*_control)[key];
-					if (bctrl.install_priority() > pctrl.install_priority())
-					{
-						found->second = best(new_version, bctrl.environment_id());
-					}
+					found = bcentry;
 				}
 			}
 		}
 	}
-	notify();
+
+	std::map<key_type,mapped_type>::iterator current = _data.find(pkgname);
+	if (found == _control->end())
+	{
+		if (current == _data.end()) return false;
+		_data.erase(current);
+		return true;
+	}
+
+	const std::string &pkgenv = found->second.environment_id();
+	if (current == _data.end())
+	{
+		_data.insert(std::make_pair(pkgname, best(found->first.pkgvrsn, pkgenv)));
+		return true;
+	}
+	if (current->second.pkgvrsn == found->first.pkgvrsn && current->second.pkgenv == pkgenv)
+	{
+		return false;
+	}
+	current->second = best(found->first.pkgvrsn, pkgenv);
+	return true;
 }
 
 
@@ -96,8 +96,16 @@ public:
 
 private:
 	virtual void handle_change(table& t);
+	virtual void handle_change(table& t,const std::set<std::string>& keys);
 	virtual void handle_change(env_checker& e);
 	void rebuild();
+
+	/**
+	 * Find the best package for one package name.
+	 * @param pkgname the package name
+	 * @return true if the best package has changed
+	 */
+	bool update_best(const std::string& pkgname);
 };
 
 } /* namespace pkg */
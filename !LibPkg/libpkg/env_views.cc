@@ -0,0 +1,109 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdexcept>
+
+#include "libpkg/env_views.h"
+
+namespace pkg {
+
+env_views::env_views(const binary_control_table& control,
+	const std::vector<env_set>& sets):
+	_sets(sets),
+	_views(sets.size())
+{
+	if (_sets.size()>max_sets)
+		throw std::invalid_argument("too many environment sets");
+
+	// The best record found so far for the current package,
+	// for each environment set.
+	std::vector<binary_control_table::const_iterator> found(_sets.size());
+
+	binary_control_table::const_iterator i=control.begin();
+	while (i!=control.end())
+	{
+		const string& pkgname=i->first.pkgname;
+		binary_control_table::const_iterator last=
+			control.equal_range(pkgname).second;
+		for (unsigned int n=0;n!=_sets.size();++n) found[n]=last;
+
+		for (;i!=last;++i)
+		{
+			mask_type mask=available(i->second.package_env());
+			for (unsigned int n=0;mask;++n,mask>>=1)
+			{
+				if (!(mask&1)) continue;
+
+				// Use the same ordering as env_packages_table:
+				// highest version first, then highest install priority.
+				binary_control_table::const_iterator& best=found[n];
+				if ((best==last)||(i->first.pkgvrsn>best->first.pkgvrsn))
+				{
+					best=i;
+				}
+				else if ((i->first.pkgvrsn==best->first.pkgvrsn)&&
+					(i->second.install_priority()>
+					best->second.install_priority()))
+				{
+					best=i;
+				}
+			}
+		}
+
+		for (unsigned int n=0;n!=_sets.size();++n)
+		{
+			if (found[n]!=last)
+			{
+				_views[n].insert(_views[n].end(),std::make_pair(pkgname,
+					env_packages_table::best(found[n]->first.pkgvrsn,
+					found[n]->second.environment_id())));
+			}
+		}
+	}
+}
+
+env_views::mask_type env_views::available(const pkg_env* env)
+{
+	std::map<const pkg_env*,mask_type>::iterator f=_env_masks.find(env);
+	if (f!=_env_masks.end()) return f->second;
+
+	mask_type mask=(_sets.empty())?0:~mask_type(0)>>(max_sets-_sets.size());
+	const std::vector<env_check*>& checks=env->checks();
+	for (unsigned int i=0;i!=checks.size();++i)
+		mask&=available(checks[i]);
+	_env_masks[env]=mask;
+	return mask;
+}
+
+env_views::mask_type env_views::available(const env_check* check)
+{
+	std::map<const env_check*,mask_type>::iterator f=
+		_check_masks.find(check);
+	if (f!=_check_masks.end()) return f->second;
+
+	mask_type mask=0;
+	for (unsigned int n=0;n!=_sets.size();++n)
+	{
+		const std::set<string>& names=(check->type()==Module)?
+			_sets[n].modules:_sets[n].envs;
+		if (names.count(check->name())) mask|=mask_type(1)<<n;
+	}
+	_check_masks[check]=mask;
+	return mask;
+}
+
+}; /* namespace pkg */
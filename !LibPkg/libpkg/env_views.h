@@ -0,0 +1,141 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_ENV_VIEWS
+#define LIBPKG_ENV_VIEWS
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "libpkg/binary_control_table.h"
+#include "libpkg/env_packages_table.h"
+
+namespace pkg {
+
+using std::string;
+
+/** A class for finding the best packages in hypothetical environments.
+ * For each of a list of environment sets this gives the package that
+ * env_packages_table would choose if env_checker::override_environment
+ * had been called with that set, but without changing the availability
+ * of any check held by the environment checker.
+ *
+ * All of the views are computed together in a single pass over the
+ * binary control table.  The availability of each package environment
+ * is represented by a bitmask with one bit per environment set, so a
+ * record is considered for every view in which it is available at the
+ * cost of testing a single word.
+ *
+ * The views are a snapshot: they are not updated if the binary control
+ * table changes.
+ */
+class env_views
+{
+public:
+	/** A type for representing the availability of an environment.
+	 * Bit n is set if the environment is available in set n.
+	 */
+	typedef unsigned long mask_type;
+
+	/** The maximum number of environment sets. */
+	static const unsigned int max_sets=sizeof(mask_type)*8;
+
+	/** A class for specifying a hypothetical environment. */
+	struct env_set
+	{
+		/** The names of the environment checks that are available. */
+		std::set<string> envs;
+
+		/** The names of the modules that are available. */
+		std::set<string> modules;
+
+		/** Construct empty environment set. */
+		env_set() {}
+
+		/** Construct environment set.
+		 * @param _envs the names of the available environment checks
+		 * @param _modules the names of the available modules
+		 */
+		env_set(const std::set<string>& _envs,
+			const std::set<string>& _modules=std::set<string>()):
+			envs(_envs),modules(_modules) {}
+	};
+
+	/** The type of a view, mapping package name to best package. */
+	typedef std::map<string,env_packages_table::best> view_type;
+private:
+	/** The environment sets. */
+	std::vector<env_set> _sets;
+
+	/** The best packages for each environment set. */
+	std::vector<view_type> _views;
+
+	/** The availability of each environment check. */
+	std::map<const env_check*,mask_type> _check_masks;
+
+	/** The availability of each package environment. */
+	std::map<const pkg_env*,mask_type> _env_masks;
+public:
+	/** Construct views.
+	 * @param control the binary control table
+	 * @param sets the environment sets, at most max_sets
+	 * @throws std::invalid_argument if there are too many sets
+	 */
+	env_views(const binary_control_table& control,
+		const std::vector<env_set>& sets);
+
+	/** Get the number of views.
+	 * @return the number of environment sets
+	 */
+	unsigned int size() const
+		{ return _views.size(); }
+
+	/** Get the environment set for a view.
+	 * @param index the index of the view
+	 * @return the environment set
+	 */
+	const env_set& set(unsigned int index) const
+		{ return _sets[index]; }
+
+	/** Get the best packages for an environment set.
+	 * @param index the index of the view
+	 * @return the view
+	 */
+	const view_type& operator[](unsigned int index) const
+		{ return _views[index]; }
+
+	/** Get the availability of a package environment.
+	 * @param env the package environment
+	 * @return a bitmask of the sets in which the environment is available
+	 */
+	mask_type available(const pkg_env* env);
+private:
+	/** Get the availability of an environment check.
+	 * This follows env_checker::override_environment: a module check
+	 * is available if its name is one of the modules of the set, and
+	 * any other check if its name is one of the environments of the set.
+	 * @param check the environment check
+	 * @return a bitmask of the sets in which the check is available
+	 */
+	mask_type available(const env_check* check);
+};
+
+}; /* namespace pkg */
+
+#endif
@@ -18,6 +18,7 @@
 
 #include "libpkg/filesystem.h"
 #include <iostream>
+#include <fstream>
 
 namespace pkg {
 
@@ -160,6 +161,29 @@ unsigned int object_length(const string& pathname)
 	return length;
 }
 
+void read_file_info(const string& pathname,unsigned int& loadaddr,
+	unsigned int& execaddr)
+{
+	// Read load and execution addresses.
+	pkg::os::OS_File17(pathname.c_str(),0,&loadaddr,&execaddr,0,0);
+}
+
+void read_file(const string& pathname,string& buffer)
+{
+	buffer.clear();
+	std::ifstream in(pathname.c_str(),std::ios::in|std::ios::binary);
+	if (!in) return;
+	in.seekg(0,std::ios::end);
+	std::streamoff length=in.tellg();
+	in.seekg(0,std::ios::beg);
+	if (length>0)
+	{
+		buffer.resize(length);
+		in.read(&buffer[0],length);
+		buffer.resize(in.gcount());
+	}
+}
+
 std::string boot_drive_relative(const string& pathname)
 {
 	std::string boot_drive = canonicalise("<Boot$Dir>.^");
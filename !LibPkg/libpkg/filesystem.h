@@ -103,6 +103,25 @@ unsigned int object_type(const string& pathname);
  */
 unsigned int object_length(const string& pathname);
 
+/** Read file information.
+ * For a timestamped file the load and execution addresses encode the
+ * filetype and the time at which the file was last modified.
+ * @param pathname the pathname of the file
+ * @param loadaddr a variable to receive the load address
+ * @param execaddr a variable to receive the execution address
+ */
+void read_file_info(const string& pathname,unsigned int& loadaddr,
+	unsigned int& execaddr);
+
+/** Read the whole of a file into memory.
+ * The content is read using a single block transfer, rather than a
+ * line or a character at a time.  If the file does not exist or cannot
+ * be read then the buffer is left empty.
+ * @param pathname the pathname
+ * @param buffer a string to which the content of the file is written
+ */
+void read_file(const string& pathname,string& buffer);
+
 /** Get version of pathname made relative the the boot drive
  * @param pathname the pathname
  * @return boot relative pathname or original if not on the boot drive
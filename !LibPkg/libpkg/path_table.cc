@@ -20,6 +20,7 @@
 #include <stdlib.h>
 
 #include "libpkg/filesystem.h"
+#include "libpkg/commit_writer.h"
 #include "libpkg/path_table.h"
 
 namespace pkg {
@@ -127,13 +128,13 @@ path_table::const_iterator path_table::find(const string& src_pathname)
 void path_table::alter(const string& src_pathname,const string& dst_pathname)
 {
 	_data[src_pathname]=dst_pathname;
-	notify();
+	notify(src_pathname);
 }
 
 void path_table::erase(const string& src_pathname)
 {
 	_data.erase(src_pathname);
-	notify();
+	notify(src_pathname);
 }
 
 void path_table::clear()
@@ -147,39 +148,15 @@ void path_table::commit()
 	// Take no action unless a pathname has been specified.
 	if (_pathname.size())
 	{
-		// Set pathnames.
-		string dst_pathname=_pathname;
-		string tmp_pathname=_pathname+string("++");
-		string bak_pathname=_pathname+string("--");
-
-		// Write new paths file.
-		std::ofstream out(tmp_pathname.c_str());
+		// Write new paths file, then move it into place.
+		commit_writer writer(_pathname);
+		std::ostream& out=writer.out();
 		for (std::map<key_type,mapped_type>::const_iterator i=_data.begin();
 			i!=_data.end();++i)
 		{
-			out << i->first << " = " << i->second << std::endl;
-		}
-		out.close();
-		if (!out) throw commit_error();
-
-		try
-		{
-			// Backup existing paths file if it exists.
-			if (object_type(dst_pathname)!=0)
-			{
-				force_move(dst_pathname,bak_pathname,true);
-			}
-
-			// Move new status file to destination.
-			force_move(tmp_pathname,dst_pathname,false);
-
-			// Delete backup.
-			force_delete(bak_pathname);
-		}
-		catch (...)
-		{
-			throw commit_error();
+			out << i->first << " = " << i->second << '\n';
 		}
+		if (!writer.commit()) throw commit_error();
 	}
 }
 
@@ -41,10 +41,15 @@ pkgbase::pkgbase(const string& pathname,const string& dpathname,
 	_selstat(pathname+string(".Selected")),
 	_env_checker_ptr(pathname+string(".ModuleIDs")),
 	_control(pathname+string(".Available")),
+	_dependencies(_control),
+	_reverse_depends(nullptr),
 	_sources(dpathname+string(".Sources"),cpathname+string(".Sources")),
 	_env_packages(nullptr),
 	_paths(pathname+string(".Paths")),
-	_changed(false)
+	_target(&_selstat),
+	_examining(0),
+	_resolve_hits(0),
+	_resolve_misses(0)
 {
 	create_directory(_pathname+string(".Cache"));
 	create_directory(_pathname+string(".Lists"));
@@ -65,9 +70,21 @@ pkgbase::pkgbase(const string& pathname,const string& dpathname,
 
 pkgbase::~pkgbase()
 {
+	delete _reverse_depends;
 	delete _env_packages;
 }
 
+const reverse_dependency_index& pkgbase::reverse_depends()
+{
+	// Create on demand, as building the index requires the dependency
+	// list of every record to be parsed.
+	if (!_reverse_depends)
+	{
+		_reverse_depends=new reverse_dependency_index(_control);
+	}
+	return *_reverse_depends;
+}
+
 env_packages_table& pkgbase::env_packages()
 {
 	// Create on demand as it gives a chance for the environment override
@@ -174,14 +191,15 @@ void pkgbase::verify_cached_file(const binary_control& ctrl)
 		throw cache_error("missing cache file",ctrl);
 
 	// Test whether file can be validated.
-	if ((ctrl.find("Size")==ctrl.end())&&(ctrl.find("MD5Sum")==ctrl.end()))
+	if ((ctrl.find(control::field_size)==ctrl.end())&&
+		(ctrl.find(control::field_md5sum)==ctrl.end()))
 	{
 		throw cache_error("cannot be validated",ctrl);
 	}
 
 	// Test whether file has expected size.
 	{
-		control::const_iterator f=ctrl.find("Size");
+		control::const_iterator f=ctrl.find(control::field_size);
 		if (f!=ctrl.end())
 		{
 			size_t size=0;
@@ -194,7 +212,7 @@ void pkgbase::verify_cached_file(const binary_control& ctrl)
 
 	// Test whether file has expected MD5Sum.
 	{
-		control::const_iterator f=ctrl.find("MD5Sum");
+		control::const_iterator f=ctrl.find(control::field_md5sum);
 		if (f!=ctrl.end())
 		{
 			std::ifstream in(pathname.c_str());
@@ -209,12 +227,30 @@ void pkgbase::verify_cached_file(const binary_control& ctrl)
 
 bool pkgbase::fix_dependencies(const std::set<string>& seed)
 {
-	// Initialise internal flags.
-	for (status_table::const_iterator i=_selstat.begin();
-		i!=_selstat.end();++i)
+	return fix_dependencies(_selstat,seed);
+}
+
+bool pkgbase::fix_dependencies(status_table& selected,
+	const std::set<string>& seed)
+{
+	_target=&selected;
+
+	// Watchers of the selected status table are notified once, when
+	// dependency resolution is complete.
+	table::batch selstat_batch(selected);
+
+	// Initialise internal flags.  Packages which would be left as they
+	// are need not be set, which keeps an overlay as small as possible.
+	for (status_table::const_iterator i=selected.begin();
+		i!=selected.end();++i)
 	{
 		string pkgname=(*i).first;
 		status selstat=(*i).second;
+		if (!selstat.flag(status::flag_must_remove)&&
+			!selstat.flag(status::flag_must_install)&&
+			!selstat.flag(status::flag_must_upgrade)&&
+			(seed.find(pkgname)==seed.end()))
+			continue;
 		selstat.flag(status::flag_must_remove,false);
 		selstat.flag(status::flag_must_install,false);
 		selstat.flag(status::flag_must_upgrade,false);
@@ -231,20 +267,29 @@ bool pkgbase::fix_dependencies(const std::set<string>& seed)
 				selstat.flag(status::flag_must_remove,true);
 			}
 		}
-		_selstat.insert(pkgname,selstat);
+		selected.insert(pkgname,selstat);
 	}
 
 	// Process packages.  Repeat until no change to flags.
 	// (This loop will terminate, because the flags can only change
 	// in one direction.)
-	_changed=true;
-	while (_changed)
+	//
+	// After the first pass a package is skipped if neither its own
+	// flags nor those of any package consulted when it was last
+	// examined have changed since then, because examining it again
+	// would have no effect.  Packages are otherwise visited in the
+	// same order as before, so the outcome does not change.
+	_dirty.clear();
+	_readers.clear();
+	_resolved.clear();
+	for (bool first_pass=true;first_pass||!_dirty.empty();first_pass=false)
 	{
-		_changed=false;
-		for (status_table::const_iterator i=_selstat.begin();
-			i!=_selstat.end();++i)
+		for (status_table::const_iterator i=selected.begin();
+			i!=selected.end();++i)
 		{
-			string pkgname=i->first;
+			if (!_dirty.erase(i->first)&&!first_pass) continue;
+			_examining=&i->first;
+			const string& pkgname=i->first;
 			const status& selstat=i->second;
 
 			if (selstat.flag(status::flag_must_install)&&
@@ -288,12 +333,17 @@ bool pkgbase::fix_dependencies(const std::set<string>& seed)
 					ensure_removed(pkgname);
 				}
 			}
-			if ((selstat.state()>status::state_removed)&&
-				!selstat.flag(status::flag_must_remove))
+
+			// The status may have been set above.  For an overlay that
+			// leaves selstat referring to the underlying table, so it
+			// must be looked up again.
+			const status& newstat=selected[pkgname];
+			if ((newstat.state()>status::state_removed)&&
+				!newstat.flag(status::flag_must_remove))
 			{
 				// This package is selected for installation, and as yet
 				// there are no known grounds for its removal.
-				binary_control_table::key_type key(pkgname,selstat.version(),selstat.environment_id());
+				binary_control_table::key_type key(pkgname,newstat.version(),newstat.environment_id());
 				bool success=fix_dependencies(_control[key],false,false);
 				if (!success)
 				{
@@ -302,13 +352,16 @@ bool pkgbase::fix_dependencies(const std::set<string>& seed)
 					ensure_removed(pkgname);
 				}
 			}
+			_examining=0;
 		}
 	}
+	_readers.clear();
+	_resolved.clear();
 
 	// Apply flags
 	bool success=true;
-	for (status_table::const_iterator i=_selstat.begin();
-		i!=_selstat.end();++i)
+	for (status_table::const_iterator i=selected.begin();
+		i!=selected.end();++i)
 	{
 		const string& pkgname=(*i).first;
 		status selstat=(*i).second;
@@ -325,7 +378,7 @@ bool pkgbase::fix_dependencies(const std::set<string>& seed)
 				pkg::binary_control_table::key_type key(pkgname, best.pkgvrsn, best.pkgenv );
 				selstat.version(best.pkgvrsn);
 				selstat.environment_id(best.pkgenv);
-				_selstat.insert(pkgname,selstat);
+				selected.insert(pkgname,selstat);
 			}
 		}
 		else if (selstat.flag(status::flag_must_remove)&&
@@ -334,7 +387,7 @@ bool pkgbase::fix_dependencies(const std::set<string>& seed)
 			selstat.flag(status::flag_auto,false);
 			if (selstat.state()>status::state_removed)
 				selstat.state(status::state_removed);
-			_selstat.insert(pkgname,selstat);
+			selected.insert(pkgname,selstat);
 		}
 		else if (selstat.flag(status::flag_must_remove)&&
 			selstat.flag(status::flag_must_install))
@@ -347,50 +400,126 @@ bool pkgbase::fix_dependencies(const std::set<string>& seed)
 
 void pkgbase::remove_auto()
 {
-	bool changed=true;
-	while (changed)
+	remove_auto(_selstat);
+}
+
+void pkgbase::remove_auto(status_table& selected)
+{
+	_target=&selected;
+
+	// Watchers of the selected status table are notified once, when
+	// all packages that are no longer needed have been removed.
+	table::batch selstat_batch(selected);
+
+	// Dependency resolution may have been abandoned part way through
+	// by an exception, in which case there is no package being examined.
+	_examining=0;
+
+	// Clear internal flags, so that dependencies are resolved against
+	// the selected state of each package alone.
+	for (status_table::const_iterator i=selected.begin();
+		i!=selected.end();++i)
 	{
-		changed=false;
+		string pkgname=i->first;
+		status selstat=i->second;
+		if (!selstat.flag(status::flag_must_remove)&&
+			!selstat.flag(status::flag_must_install)&&
+			!selstat.flag(status::flag_must_upgrade))
+			continue;
+		selstat.flag(status::flag_must_remove,false);
+		selstat.flag(status::flag_must_install,false);
+		selstat.flag(status::flag_must_upgrade,false);
+		selected.insert(pkgname,selstat);
+	}
 
-		// Mark auto-installed packages for removal
-		for (status_table::const_iterator i=_selstat.begin();
-			i!=_selstat.end();++i)
+	// Find the record selected for each installed package.  Those of
+	// auto-installed packages are where the search below begins.
+	std::vector<std::pair<string,const pkg::control*> > upstream;
+	std::unordered_set<const pkg::control*> others;
+	for (status_table::const_iterator i=selected.begin();
+		i!=selected.end();++i)
+	{
+		const string& pkgname=i->first;
+		const status& selstat=i->second;
+		if (selstat.state()>=status::state_installed)
 		{
-			string pkgname=i->first;
-			status selstat=i->second;
-			selstat.flag(status::flag_must_remove,false);
-			selstat.flag(status::flag_must_install,false);
-			selstat.flag(status::flag_must_upgrade,false);
-			_selstat.insert(pkgname,selstat);
+			binary_control_table::key_type key(pkgname,selstat.version(),selstat.environment_id());
+			const pkg::control* ctrl=&_control[key];
+			if (selstat.flag(status::flag_auto))
+				upstream.push_back(std::make_pair(pkgname,ctrl));
+			else others.insert(ctrl);
 		}
+	}
+	unsigned int auto_count=upstream.size();
 
-		// Unmark packages that are still needed
-		for (status_table::const_iterator i=_selstat.begin();
-			i!=_selstat.end();++i)
+	// Find the packages which depend, directly or indirectly, on an
+	// auto-installed package, using the reverse dependency index.  Only
+	// these can be on a path from a root to an auto-installed package,
+	// so the others can be left out of the dependency graph.
+	for (unsigned int i=0;i!=upstream.size();++i)
+	{
+		const reverse_dependency_index::record_list& dependents=
+			reverse_depends().dependents(upstream[i].first);
+		for (reverse_dependency_index::record_list::const_iterator
+			j=dependents.begin();j!=dependents.end();++j)
 		{
-			string pkgname=i->first;
-			const status& selstat=i->second;
-			if (selstat.state()>=status::state_installed)
-			{
-				binary_control_table::key_type key(pkgname,selstat.version(),selstat.environment_id());
-				fix_dependencies(_control[key],true,true);
-			}
+			// Only a record selected for installation counts.
+			const pkg::control* ctrl=&(*j)->second;
+			if (others.erase(ctrl))
+				upstream.push_back(std::make_pair((*j)->first.pkgname,ctrl));
 		}
+	}
 
-		// Remove packages no longer needed
-		for (std::map<string,status>::const_iterator i=_selstat.begin();
-			i!=_selstat.end();++i)
+	// Build the dependency graph.  For each of those packages, the
+	// edges lead to the packages chosen to satisfy its dependencies.
+	// Packages that were installed manually are the roots.
+	std::unordered_map<string,std::vector<string> > graph;
+	std::vector<string> pending;
+	_resolved.clear();
+	for (unsigned int i=0;i!=upstream.size();++i)
+	{
+		const string& pkgname=upstream[i].first;
+		const dependency_cache::list_type& deps=
+			_dependencies[upstream[i].second->depends()];
+		std::vector<string>& edges=graph[pkgname];
+		for (dependency_cache::list_type::const_iterator j=deps.begin();
+			j!=deps.end();++j)
 		{
-			string pkgname=i->first;
-			status selstat=i->second;
-			if (selstat.flag(status::flag_auto)&&
-				!selstat.flag(status::flag_must_install))
-			{
-				selstat.state(status::state_removed);
-				selstat.flag(status::flag_auto,false);
-				_selstat.insert(pkgname,selstat);
-				changed=true;
-			}
+			if (const pkg::control* ctrl=resolve(*j,true))
+				edges.push_back(ctrl->pkgname());
+		}
+		if (i>=auto_count) pending.push_back(pkgname);
+	}
+	_resolved.clear();
+
+	// Mark every package reachable from a root.
+	std::set<string> needed(pending.begin(),pending.end());
+	while (!pending.empty())
+	{
+		string pkgname=pending.back();
+		pending.pop_back();
+		std::unordered_map<string,std::vector<string> >::const_iterator
+			f=graph.find(pkgname);
+		if (f==graph.end()) continue;
+		const std::vector<string>& edges=f->second;
+		for (std::vector<string>::const_iterator j=edges.begin();
+			j!=edges.end();++j)
+		{
+			if (needed.insert(*j).second) pending.push_back(*j);
+		}
+	}
+
+	// Remove auto-installed packages that are not needed.
+	for (status_table::const_iterator i=selected.begin();
+		i!=selected.end();++i)
+	{
+		string pkgname=i->first;
+		status selstat=i->second;
+		if (selstat.flag(status::flag_auto)&&!needed.count(pkgname))
+		{
+			selstat.state(status::state_removed);
+			selstat.flag(status::flag_auto,false);
+			selected.insert(pkgname,selstat);
 		}
 	}
 }
@@ -405,10 +534,8 @@ bool pkgbase::fix_dependencies(const pkg::control& ctrl,bool allow_new)
 bool pkgbase::fix_dependencies(const pkg::control& ctrl,bool allow_new,
 	bool apply)
 {
-	// Parse dependency list.
-	std::vector<std::vector<dependency> > deps;
-	string deplist=ctrl.depends();
-	parse_dependency_list(deplist.begin(),deplist.end(),&deps);
+	// Parse dependency list, unless it has already been parsed.
+	const dependency_cache::list_type& deps=_dependencies[ctrl.depends()];
 
 	// Process dependency list.
 	bool success=true;
@@ -457,8 +584,42 @@ const pkg::control* pkgbase::resolve(const std::vector<dependency>& deps,
 const pkg::control* pkgbase::resolve(const dependency& dep,bool allow_new)
 {
 	// Select package.
-	string pkgname=dep.pkgname();
-	const status& selstat=_selstat[pkgname];
+	const string& pkgname=dep.pkgname();
+	const status& selstat=(*_target)[pkgname];
+	if (_examining)
+	{
+		// Record that the package being examined has consulted the
+		// status of this one, unless that is already known.
+		std::vector<const string*>& readers=_readers[pkgname];
+		if (readers.empty()||(readers.back()!=_examining))
+			readers.push_back(_examining);
+	}
+
+	// The result depends only on the dependency and the status of the
+	// package, so if the same dependency has been resolved since the
+	// status last changed then the same result can be used again.
+	std::vector<resolution>& resolved=_resolved[pkgname];
+	for (std::vector<resolution>::const_iterator i=resolved.begin();
+		i!=resolved.end();++i)
+	{
+		if ((i->allow_new==allow_new)&&((i->dep==&dep)||
+			((i->dep->relation()==dep.relation())&&
+			(i->dep->version()==dep.version()))))
+		{
+			++_resolve_hits;
+			return i->ctrl;
+		}
+	}
+	++_resolve_misses;
+	const pkg::control* ctrl=match(dep,selstat,allow_new);
+	resolved.push_back(resolution(&dep,allow_new,ctrl));
+	return ctrl;
+}
+
+const pkg::control* pkgbase::match(const dependency& dep,
+	const status& selstat,bool allow_new)
+{
+	const string& pkgname=dep.pkgname();
 
 	// Resolution always fails if the package is flagged for removal.
 	if (selstat.flag(status::flag_must_remove)) return 0;
@@ -473,7 +634,9 @@ const pkg::control* pkgbase::resolve(const dependency& dep,bool allow_new)
 		string envid=selstat.environment_id();
 		binary_control_table::key_type key(pkgname,pkgvrsn,envid);
 		const pkg::control& ctrl=_control[key];
-		if (dep.matches(ctrl.pkgname(),ctrl.version()))
+		unsigned int rank=_control.rank(pkgname,pkgvrsn);
+		if ((rank!=binary_control_table::no_rank)&&
+			dep.matches(ctrl.pkgname(),_control.ranked_version(pkgname,rank)))
 			return &ctrl;
 	}
 
@@ -487,7 +650,7 @@ const pkg::control* pkgbase::resolve(const dependency& dep,bool allow_new)
 		{
 			binary_control_table::key_type key(pkgname,found_pkg->second.pkgvrsn,found_pkg->second.pkgenv);
 			const pkg::control& ctrl=_control[key];
-			if (dep.matches(ctrl.pkgname(),ctrl.version()))
+			if (dep.matches(ctrl.pkgname(),found_pkg->second.pkgvrsn))
 				return &ctrl;
 		}
 	}
@@ -499,7 +662,7 @@ const pkg::control* pkgbase::resolve(const dependency& dep,bool allow_new)
 void pkgbase::ensure_installed(const string& pkgname,const string& pkgvrsn,const string &pkgenv)
 {
 	bool changed=false;
-	status selstat=_selstat[pkgname];
+	status selstat=(*_target)[pkgname];
 	if (!selstat.flag(status::flag_must_install))
 	{
 		selstat.flag(status::flag_must_install,true);
@@ -508,7 +671,7 @@ void pkgbase::ensure_installed(const string& pkgname,const string& pkgvrsn,const
 	if (!selstat.flag(status::flag_must_upgrade))
 	{
 		if ((selstat.state()<status::state_installed)||
-			(version(selstat.version())!=version(pkgvrsn)))
+			!same_version(pkgname,selstat.version(),pkgvrsn))
 		{
 			selstat.flag(status::flag_must_upgrade,true);
 			changed=true;
@@ -518,15 +681,28 @@ void pkgbase::ensure_installed(const string& pkgname,const string& pkgvrsn,const
 	{
 		// Ensure we get the package for the correct environment
 		selstat.environment_id(pkgenv);
-		_selstat.insert(pkgname,selstat);
-		_changed=true;
+		_target->insert(pkgname,selstat);
+		mark_changed(pkgname);
 	}
 }
 
+bool pkgbase::same_version(const string& pkgname,const string& lhs,
+	const string& rhs) const
+{
+	// Compare ranks if both versions are in the package database,
+	// otherwise parse the version strings.
+	unsigned int lrank=_control.rank(pkgname,lhs);
+	unsigned int rrank=_control.rank(pkgname,rhs);
+	if ((lrank!=binary_control_table::no_rank)&&
+		(rrank!=binary_control_table::no_rank))
+		return lrank==rrank;
+	return version(lhs)==version(rhs);
+}
+
 void pkgbase::ensure_removed(const string& pkgname)
 {
 	bool changed=false;
-	status selstat=_selstat[pkgname];
+	status selstat=(*_target)[pkgname];
 	if (!selstat.flag(status::flag_must_remove))
 	{
 		selstat.flag(status::flag_must_remove,true);
@@ -534,8 +710,24 @@ void pkgbase::ensure_removed(const string& pkgname)
 	}
 	if (changed)
 	{
-		_selstat.insert(pkgname,selstat);
-		_changed=true;
+		_target->insert(pkgname,selstat);
+		mark_changed(pkgname);
+	}
+}
+
+void pkgbase::mark_changed(const string& pkgname)
+{
+	_resolved.erase(pkgname);
+	if (!_examining) return;
+	_dirty.insert(pkgname);
+	std::unordered_map<string,std::vector<const string*> >::iterator f=
+		_readers.find(pkgname);
+	if (f!=_readers.end())
+	{
+		const std::vector<const string*>& readers=f->second;
+		for (std::vector<const string*>::const_iterator i=readers.begin();
+			i!=readers.end();++i)
+			_dirty.insert(**i);
 	}
 }
 
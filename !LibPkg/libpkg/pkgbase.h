@@ -18,8 +18,14 @@
 #define LIBPKG_PKGBASE
 
 #include <string>
+#include <set>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "libpkg/dependency.h"
+#include "libpkg/dependency_cache.h"
+#include "libpkg/reverse_dependency_index.h"
 #include "libpkg/status_table.h"
 #include "libpkg/binary_control_table.h"
 #include "libpkg/source_table.h"
@@ -61,6 +67,13 @@ private:
 	/** The binary control table. */
 	binary_control_table _control;
 
+	/** The parsed dependency lists of the binary control table. */
+	dependency_cache _dependencies;
+
+	/** The reverse dependencies of the binary control table,
+	 * or 0 if not yet needed. */
+	reverse_dependency_index* _reverse_depends;
+
 	/** The source table. */
 	source_table _sources;
 
@@ -70,14 +83,72 @@ private:
 	/** The path table. */
 	path_table _paths;
 
-	/** The changed flag.
-	 * True if any of the must-remove, must-install or must-upgrade
-	 * flags have changed since the start of the current round of
-	 * dependency resolution.  Note that this flag is only meaningful
-	 * during dependency resolution, and it only captures changes
-	 * made using the functions ensure_removed() and ensure_installed().
+	/** The status table to which dependency resolution is applied.
+	 * This is normally the selected status table, but may be an overlay
+	 * on it if the outcome of a change is being planned.
+	 */
+	status_table* _target;
+
+	/** The set of packages that must be re-examined.
+	 * A package must be re-examined during dependency resolution if
+	 * its own flags, or those of any package that was consulted when
+	 * it was last examined, have changed since then.  Note that this
+	 * set is only meaningful during dependency resolution, and it only
+	 * captures changes made using the functions ensure_removed() and
+	 * ensure_installed().
+	 */
+	std::unordered_set<string> _dirty;
+
+	/** A map from package name to the packages which consulted the
+	 * status of that package when they were examined.
+	 * The names point to keys of the status table being resolved.
+	 * This is only meaningful during dependency resolution.
 	 */
-	bool _changed;
+	std::unordered_map<string,std::vector<const string*> > _readers;
+
+	/** The name of the package being examined, or 0 if none.
+	 * This is only non-zero during dependency resolution.
+	 */
+	const string* _examining;
+
+	/** A class for recording the result of resolving a dependency. */
+	struct resolution
+	{
+		/** The dependency.
+		 * This points into the dependency cache, which does not
+		 * change during a pass.
+		 */
+		const dependency* dep;
+
+		/** True if packages that are not currently installed were
+		 * allowed, otherwise false. */
+		bool allow_new;
+
+		/** The control record of the package chosen, or 0 if none. */
+		const pkg::control* ctrl;
+
+		/** Construct resolution.
+		 * @param _dep the dependency
+		 * @param _allow_new true if new packages were allowed
+		 * @param _ctrl the control record of the package chosen
+		 */
+		resolution(const dependency* _dep,bool _allow_new,
+			const pkg::control* _ctrl):
+			dep(_dep),allow_new(_allow_new),ctrl(_ctrl) {}
+	};
+
+	/** A map from package name to the dependencies on that package
+	 * which have been resolved during the current pass.
+	 * The entries for a package are discarded whenever its status
+	 * is changed by ensure_installed() or ensure_removed().
+	 */
+	std::unordered_map<string,std::vector<resolution> > _resolved;
+
+	/** The number of dependencies resolved from _resolved. */
+	unsigned long _resolve_hits;
+
+	/** The number of dependencies that had to be resolved in full. */
+	unsigned long _resolve_misses;
 public:
 	/** Create pkgbase object.
 	 * @param pathname the pathname of the !Packages directory.
@@ -116,6 +187,13 @@ public:
 	binary_control_table& control()
 		{ return _control; }
 
+	/** Get reverse dependency index.
+	 * The index is built when first needed, then kept up to date with
+	 * the binary control table.
+	 * @return the index of packages which depend on each package
+	 */
+	const reverse_dependency_index& reverse_depends();
+
 	/** Get source table.
 	 * @return the source table
 	 */
@@ -129,6 +207,19 @@ public:
 	 */
 	env_packages_table& env_packages();
 
+	/** Get the number of dependencies that were resolved using the
+	 * result of an earlier resolution within the same pass.
+	 * @return the number of hits
+	 */
+	unsigned long resolve_hits() const
+		{ return _resolve_hits; }
+
+	/** Get the number of dependencies that had to be resolved in full.
+	 * @return the number of misses
+	 */
+	unsigned long resolve_misses() const
+		{ return _resolve_misses; }
+
 	/** Get path table.
 	 * @return the path table
 	 */
@@ -207,9 +298,39 @@ public:
 	 */
 	bool fix_dependencies(const std::set<string>& seed);
 
+	/** Fix dependencies in a given status table.
+	 * This behaves as fix_dependencies(seed), except that the changes
+	 * are made to the given table instead of the selected status table.
+	 * If that table is an overlay on the selected status table then the
+	 * changes needed can be found without altering the selection:
+	 * @code
+	 * status_table plan(&pb.selstat());
+	 * plan.insert(pkgname,newstat);
+	 * pb.fix_dependencies(plan,seed);
+	 * pb.remove_auto(plan);
+	 * transaction_plan tp(pb.curstat(),plan,pb.control());
+	 * @endcode
+	 * @param selected the table to be fixed
+	 * @param seed the seed set
+	 * @return true if all dependencies were fixed, otherwise false
+	 */
+	bool fix_dependencies(status_table& selected,
+		const std::set<string>& seed);
+
 	/** Remove redundant auto-installed packages.
+	 * Packages are needed if they were installed manually, or if they
+	 * can be reached from such a package by following the packages
+	 * chosen to satisfy the dependencies of each installed package.
+	 * Any auto-installed package that is not needed is removed.
 	 */
 	void remove_auto();
+
+	/** Remove redundant auto-installed packages from a given status table.
+	 * This behaves as remove_auto(), except that the changes are made
+	 * to the given table instead of the selected status table.
+	 * @param selected the table from which packages are to be removed
+	 */
+	void remove_auto(status_table& selected);
 private:
 	/** Fix dependencies for package.
 	 * Flags are altered if and only if all dependencies can be satisifed.
@@ -262,6 +383,25 @@ control record
 	const pkg::control* resolve(const dependency& dep,
 		bool allow_new=true);
 
+	/** Resolve dependency without reference to earlier resolutions.
+	 * @param dep the depenency to be satisfied
+	 * @param selstat the selected status of the package
+	 * @param allow_new true to allow packages that are not currently
+	 *  installed, otherwise false
+	 * @return the control record of a package that would satisfy the
+	 *  dependency, or 0 if none found
+	 */
+	const pkg::control* match(const dependency& dep,
+		const status& selstat,bool allow_new);
+
+	/** Record that the flags of a package have changed.
+	 * Any earlier resolutions of dependencies on the package are
+	 * discarded.  The package, and any package that consulted its
+	 * status when it was last examined, are marked for re-examination.
+	 * @param pkgname the package name
+	 */
+	void mark_changed(const string& pkgname);
+
 	/** Ensure that package will be removed.
 	 * The must-remove flag is set if it is not already.
 	 * @param pkgname the package name
@@ -278,6 +418,17 @@ control record
 	 */
 	void ensure_installed(const string& pkgname,const string& pkgvrsn,const string &pkgenv);
 
+	/** Test whether two versions of a package are equal.
+	 * The versions are compared by rank if both are in the package
+	 * database, so that they do not need to be parsed.
+	 * @param pkgname the package name
+	 * @param lhs the left hand side
+	 * @param rhs the right hand side
+	 * @return true if lhs==rhs, otherwise false
+	 */
+	bool same_version(const string& pkgname,const string& lhs,
+		const string& rhs) const;
+
     /** Update status table to new version if necessary.
 	 * @param update_table the table to update
 	 * @return true if the table needed to be updated
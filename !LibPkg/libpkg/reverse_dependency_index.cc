@@ -0,0 +1,171 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "libpkg/dependency.h"
+#include "libpkg/reverse_dependency_index.h"
+
+namespace pkg {
+
+reverse_dependency_index::reverse_dependency_index(
+	binary_control_table& control):
+	_control(control)
+{
+	rebuild();
+	watch(control);
+}
+
+reverse_dependency_index::~reverse_dependency_index()
+{}
+
+const reverse_dependency_index::record_list&
+	reverse_dependency_index::dependents(const string& pkgname) const
+{
+	static const record_list empty;
+	std::unordered_map<string,record_list>::const_iterator f=
+		_index.find(pkgname);
+	return (f!=_index.end())?f->second:empty;
+}
+
+std::set<string> reverse_dependency_index::required_by(
+	const string& pkgname,const status_table& stat) const
+{
+	std::set<string> result;
+	const record_list& records=dependents(pkgname);
+	for (record_list::const_iterator i=records.begin();
+		i!=records.end();++i)
+	{
+		const binary_control_table::key_type& key=(*i)->first;
+		const status& st=stat[key.pkgname];
+		if ((st.state()>=status::state_installed)&&
+			(st.environment_id()==key.pkgenv)&&
+			(((*i)->second.version()==st.version())||
+			(key.pkgvrsn==version(st.version()))))
+		{
+			result.insert(key.pkgname);
+		}
+	}
+	return result;
+}
+
+std::set<string> reverse_dependency_index::required_by(
+	const string& pkgname,const env_packages_table& env) const
+{
+	std::set<string> result;
+	const record_list& records=dependents(pkgname);
+	for (record_list::const_iterator i=records.begin();
+		i!=records.end();++i)
+	{
+		const binary_control_table::key_type& key=(*i)->first;
+		env_packages_table::const_iterator f=env.find(key.pkgname);
+		if ((f!=env.end())&&(f->second.pkgenv==key.pkgenv)&&
+			(f->second.pkgvrsn==key.pkgvrsn))
+		{
+			result.insert(key.pkgname);
+		}
+	}
+	return result;
+}
+
+void reverse_dependency_index::handle_change(table& t)
+{
+	rebuild();
+}
+
+void reverse_dependency_index::handle_change(table& t,
+	const std::set<string>& keys)
+{
+	for (std::set<string>::const_iterator i=keys.begin();
+		i!=keys.end();++i)
+	{
+		remove(*i);
+		add(*i);
+	}
+}
+
+void reverse_dependency_index::rebuild()
+{
+	_index.clear();
+	_depends.clear();
+	binary_control_table::const_iterator i=_control.begin();
+	while (i!=_control.end())
+	{
+		const string& pkgname=i->first.pkgname;
+		add(pkgname);
+		i=_control.equal_range(pkgname).second;
+	}
+}
+
+void reverse_dependency_index::add(const string& pkgname)
+{
+	std::vector<string>& depends=_depends[pkgname];
+	const record_list& records=_control.records(pkgname);
+	std::vector<std::vector<dependency> > deps;
+	for (record_list::const_iterator i=records.begin();
+		i!=records.end();++i)
+	{
+		// Parse the dependency list.  A record which names the same
+		// package more than once is listed against it only once.
+		const string& deplist=(*i)->second.depends();
+		deps.clear();
+		parse_dependency_list(deplist.begin(),deplist.end(),&deps);
+		for (std::vector<std::vector<dependency> >::const_iterator
+			j=deps.begin();j!=deps.end();++j)
+		{
+			for (std::vector<dependency>::const_iterator
+				k=j->begin();k!=j->end();++k)
+			{
+				record_list& dependents=_index[k->pkgname()];
+				if (dependents.empty()||(dependents.back()!=*i))
+				{
+					dependents.push_back(*i);
+					depends.push_back(k->pkgname());
+				}
+			}
+		}
+	}
+
+	// Each package on which this one depends need only be recorded once.
+	std::sort(depends.begin(),depends.end());
+	depends.erase(std::unique(depends.begin(),depends.end()),
+		depends.end());
+	if (depends.empty()) _depends.erase(pkgname);
+}
+
+void reverse_dependency_index::remove(const string& pkgname)
+{
+	std::unordered_map<string,std::vector<string> >::iterator f=
+		_depends.find(pkgname);
+	if (f==_depends.end()) return;
+	const std::vector<string>& depends=f->second;
+	for (std::vector<string>::const_iterator i=depends.begin();
+		i!=depends.end();++i)
+	{
+		record_list& dependents=_index[*i];
+		record_list::iterator j=dependents.begin();
+		while (j!=dependents.end())
+		{
+			if ((*j)->first.pkgname==pkgname) j=dependents.erase(j);
+			else ++j;
+		}
+		if (dependents.empty()) _index.erase(*i);
+	}
+	_depends.erase(f);
+}
+
+}; /* namespace pkg */
@@ -0,0 +1,123 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_REVERSE_DEPENDENCY_INDEX
+#define LIBPKG_REVERSE_DEPENDENCY_INDEX
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "libpkg/binary_control_table.h"
+#include "libpkg/status_table.h"
+#include "libpkg/env_packages_table.h"
+
+namespace pkg {
+
+using std::string;
+
+/** A class for finding the packages which depend on a given package.
+ * For each package name the index holds the records of the binary
+ * control table whose Depends field mentions that package, so that
+ * the dependents of a package can be found without parsing the
+ * dependency list of every record.  A record that can be satisfied by
+ * any one of several alternatives is listed against each of them.
+ *
+ * The index watches the binary control table.  When records for
+ * particular packages are inserted only the entries for those packages
+ * are rebuilt, otherwise the whole index is rebuilt.
+ */
+class reverse_dependency_index:
+	private table::watcher
+{
+public:
+	/** The type of a list of records. */
+	typedef binary_control_table::record_list record_list;
+private:
+	/** The binary control table. */
+	const binary_control_table& _control;
+
+	/** A map from package name to the records which depend on it. */
+	std::unordered_map<string,record_list> _index;
+
+	/** A map from package name to the names of the packages on which
+	 * its records depend.
+	 * This is used to remove the entries for a package when its
+	 * records change.
+	 */
+	std::unordered_map<string,std::vector<string> > _depends;
+public:
+	/** Construct reverse dependency index.
+	 * @param control the binary control table to be indexed
+	 */
+	reverse_dependency_index(binary_control_table& control);
+
+	/** Destroy reverse dependency index. */
+	virtual ~reverse_dependency_index();
+
+	/** Get the records which depend on a package.
+	 * Every version of every package is included, whether or not
+	 * it is available or installed.
+	 * @param pkgname the package name
+	 * @return the records, which may be in any order
+	 */
+	const record_list& dependents(const string& pkgname) const;
+
+	/** Get the installed packages which depend on a package.
+	 * A package is included if it is installed according to the given
+	 * status table, and the record for the installed version and
+	 * environment depends on the given package.
+	 * @param pkgname the package name
+	 * @param stat the status table, typically the current or selected
+	 *  status table
+	 * @return the names of the dependent packages
+	 */
+	std::set<string> required_by(const string& pkgname,
+		const status_table& stat) const;
+
+	/** Get the available packages which depend on a package.
+	 * A package is included if the record for the best version in
+	 * the given environment packages table depends on the given
+	 * package.
+	 * @param pkgname the package name
+	 * @param env the environment packages table
+	 * @return the names of the dependent packages
+	 */
+	std::set<string> required_by(const string& pkgname,
+		const env_packages_table& env) const;
+private:
+	virtual void handle_change(table& t);
+	virtual void handle_change(table& t,const std::set<string>& keys);
+
+	/** Rebuild the whole index. */
+	void rebuild();
+
+	/** Add the records for one package to the index.
+	 * @param pkgname the package name
+	 */
+	void add(const string& pkgname);
+
+	/** Remove the records for one package from the index.
+	 * @param pkgname the package name
+	 */
+	void remove(const string& pkgname);
+};
+
+}; /* namespace pkg */
+
+#endif
@@ -0,0 +1,175 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_SHARED_STRING
+#define LIBPKG_SHARED_STRING
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace pkg {
+
+using std::string;
+
+/** A class to represent an immutable string which may be shared.
+ * The characters are held through a reference-counted handle, so
+ * copying a shared_string never copies them, and two copies of the same
+ * value can be recognised by identity.  A shared_string can be used
+ * wherever a const std::string& is expected.  Assigning a new value
+ * replaces the handle, and does not affect other copies.
+ */
+class shared_string
+{
+private:
+	/** The value, or null if the value is empty. */
+	std::shared_ptr<const string> _value;
+public:
+	/** Construct empty shared string. */
+	shared_string()
+	{}
+
+	/** Construct shared string from string.
+	 * @param value the value
+	 */
+	shared_string(const string& value):
+		_value((value.empty())?0:std::make_shared<string>(value))
+	{}
+
+	/** Construct shared string from temporary string.
+	 * @param value the value, which is moved into the shared string
+	 */
+	shared_string(string&& value):
+		_value((value.empty())?0:std::make_shared<string>(std::move(value)))
+	{}
+
+	/** Construct shared string from C-string.
+	 * @param value the value
+	 */
+	shared_string(const char* value):
+		_value((*value)?std::make_shared<string>(value):0)
+	{}
+
+	/** Convert to string.
+	 * @return the value
+	 */
+	operator const string&() const
+		{ return str(); }
+
+	/** Get the value.
+	 * @return the value
+	 */
+	const string& str() const
+		{ return (_value)?*_value:empty_string(); }
+
+	/** Get the length of the value.
+	 * @return the length
+	 */
+	string::size_type size() const
+		{ return str().size(); }
+
+	/** Get the length of the value.
+	 * @return the length
+	 */
+	string::size_type length() const
+		{ return str().length(); }
+
+	/** Test whether the value is empty.
+	 * @return true if empty, otherwise false
+	 */
+	bool empty() const
+		{ return !_value; }
+
+	/** Get the value as a C-string.
+	 * @return the value, terminated by a null character
+	 */
+	const char* c_str() const
+		{ return str().c_str(); }
+
+	/** Get the characters of the value.
+	 * @return the characters
+	 */
+	const char* data() const
+		{ return str().data(); }
+
+	/** Test whether two shared strings share storage.
+	 * This takes constant time.  Empty values never share storage.
+	 * A result of false does not mean that the values differ.
+	 * @param that the shared string to compare with
+	 * @return true if this and that share storage, otherwise false
+	 */
+	bool identical(const shared_string& that) const
+		{ return _value&&(_value==that._value); }
+
+	/** Get the number of shared strings which share this one's storage.
+	 * @return the number of shared strings, including this one, or 0
+	 *  if the value is empty
+	 */
+	long use_count() const
+		{ return _value.use_count(); }
+private:
+	/** Get the empty string.
+	 * @return a reference to an empty string
+	 */
+	static const string& empty_string()
+	{
+		static const string empty;
+		return empty;
+	}
+};
+
+inline bool operator==(const shared_string& lhs,const shared_string& rhs)
+	{ return lhs.identical(rhs)||(lhs.str()==rhs.str()); }
+
+inline bool operator==(const shared_string& lhs,const string& rhs)
+	{ return lhs.str()==rhs; }
+
+inline bool operator==(const string& lhs,const shared_string& rhs)
+	{ return lhs==rhs.str(); }
+
+inline bool operator==(const shared_string& lhs,const char* rhs)
+	{ return lhs.str()==rhs; }
+
+inline bool operator==(const char* lhs,const shared_string& rhs)
+	{ return lhs==rhs.str(); }
+
+inline bool operator!=(const shared_string& lhs,const shared_string& rhs)
+	{ return !(lhs==rhs); }
+
+inline bool operator!=(const shared_string& lhs,const string& rhs)
+	{ return !(lhs==rhs); }
+
+inline bool operator!=(const string& lhs,const shared_string& rhs)
+	{ return !(lhs==rhs); }
+
+inline bool operator!=(const shared_string& lhs,const char* rhs)
+	{ return !(lhs==rhs); }
+
+inline bool operator!=(const char* lhs,const shared_string& rhs)
+	{ return !(lhs==rhs); }
+
+/** Write shared string to output stream.
+ * @param out the output stream
+ * @param value the shared string
+ * @return the output stream
+ */
+inline std::ostream& operator<<(std::ostream& out,const shared_string& value)
+	{ return out << value.str(); }
+
+}; /* namespace pkg */
+
+#endif
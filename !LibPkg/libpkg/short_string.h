@@ -0,0 +1,183 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_SHORT_STRING
+#define LIBPKG_SHORT_STRING
+
+#include <cstring>
+#include <string>
+
+namespace pkg {
+
+using std::string;
+
+/** A class to represent a string which is usually short.
+ * A string of up to the given capacity is held within the object
+ * itself, so that it can be constructed, copied and destroyed without
+ * allocating any memory.  A longer string is held on the heap.
+ */
+template<unsigned int capacity>
+class short_string
+{
+private:
+	/** The length of the string. */
+	unsigned int _length;
+
+	union
+	{
+		/** The content of the string, if it is no longer than the
+		 * capacity. */
+		char _inline[capacity];
+
+		/** The content of the string, if it is longer than the
+		 * capacity. */
+		char* _heap;
+	};
+public:
+	/** Construct empty short string. */
+	short_string():
+		_length(0)
+	{}
+
+	/** Construct short string from character array.
+	 * @param s the characters
+	 * @param length the number of characters
+	 */
+	short_string(const char* s,unsigned int length):
+		_length(0)
+	{
+		resize(length);
+		std::memcpy(data(),s,length);
+	}
+
+	/** Construct short string from string.
+	 * @param s the string
+	 */
+	short_string(const string& s):
+		_length(0)
+	{
+		resize(s.length());
+		std::memcpy(data(),s.data(),s.length());
+	}
+
+	/** Construct copy of short string.
+	 * @param s the short string to be copied
+	 */
+	short_string(const short_string& s):
+		_length(0)
+	{
+		resize(s._length);
+		std::memcpy(data(),s.data(),s._length);
+	}
+
+	/** Destroy short string. */
+	~short_string()
+	{
+		if (_length>capacity) delete[] _heap;
+	}
+
+	/** Assign short string.
+	 * @param s the short string to be assigned
+	 * @return a reference to this
+	 */
+	short_string& operator=(const short_string& s)
+	{
+		if (&s!=this)
+		{
+			resize(s._length);
+			std::memcpy(data(),s.data(),s._length);
+		}
+		return *this;
+	}
+
+	/** Convert short string to string.
+	 * @return the string
+	 */
+	operator string() const
+		{ return string(data(),_length); }
+
+	/** Get the length of the string.
+	 * @return the number of characters
+	 */
+	unsigned int length() const
+		{ return _length; }
+
+	/** Test whether the string is empty.
+	 * @return true if empty, otherwise false
+	 */
+	bool empty() const
+		{ return !_length; }
+
+	/** Get the characters of the string.
+	 * They are not followed by a NUL.
+	 * @return a pointer to the first character
+	 */
+	const char* data() const
+		{ return (_length>capacity)?_heap:_inline; }
+
+	/** Get the characters of the string for modification.
+	 * @return a pointer to the first character
+	 */
+	char* data()
+		{ return (_length>capacity)?_heap:_inline; }
+
+	/** Change the length of the string.
+	 * The content of the string is unspecified afterwards, and is
+	 * expected to be written through data().
+	 * @param length the required number of characters
+	 */
+	void resize(unsigned int length)
+	{
+		if (length>capacity)
+		{
+			char* heap=new char[length];
+			if (_length>capacity) delete[] _heap;
+			_heap=heap;
+		}
+		else if (_length>capacity) delete[] _heap;
+		_length=length;
+	}
+};
+
+/** Test whether two short strings are equal.
+ * @param lhs the left hand side
+ * @param rhs the right hand side
+ * @return true if lhs==rhs, otherwise false
+ */
+template<unsigned int capacity>
+inline bool operator==(const short_string<capacity>& lhs,
+	const short_string<capacity>& rhs)
+{
+	return (lhs.length()==rhs.length())&&
+		!std::memcmp(lhs.data(),rhs.data(),lhs.length());
+}
+
+/** Test whether two short strings are unequal.
+ * @param lhs the left hand side
+ * @param rhs the right hand side
+ * @return true if lhs!=rhs, otherwise false
+ */
+template<unsigned int capacity>
+inline bool operator!=(const short_string<capacity>& lhs,
+	const short_string<capacity>& rhs)
+{
+	return !(lhs==rhs);
+}
+
+}; /* namespace pkg */
+
+#endif
@@ -15,53 +15,80 @@
 // limitations under the License.
 
 #include <fstream>
+#include <stdexcept>
 
 #include "libpkg/filesystem.h"
+#include "libpkg/commit_writer.h"
 #include "libpkg/status.h"
 #include "libpkg/status_table.h"
 
 namespace pkg {
 
 status_table::status_table(const string& pathname):
-	_pathname(pathname)
+	_pathname(pathname),
+	_base(0),
+	_generation(0)
 {
 	rollback();
 }
 
+status_table::status_table(const status_table* base):
+	_base(base),
+	_generation(0)
+{
+	// Lookup and iteration consult only one level of underlying table.
+	if (_base&&_base->_base)
+		throw std::invalid_argument("cannot overlay a status table overlay");
+}
+
 status_table::~status_table()
 {}
 
 const status_table::mapped_type&
 	status_table::operator[](const key_type& key) const
 {
+	data_type::const_iterator f=_data.find(key);
+	if (f!=_data.end()) return f->second;
+	if (_base) return (*_base)[key];
 	static mapped_type default_value;
-	const_iterator f=_data.find(key);
-	return (f!=_data.end())?f->second:default_value;
+	return default_value;
 }
 
 status_table::const_iterator status_table::find(const key_type& key) const
 {
-	return _data.find(key);
+	if (!_base) return const_iterator(*this,_data.find(key));
+
+	const data_type& base_data=_base->_data;
+	data_type::const_iterator f=_data.find(key);
+	if (f!=_data.end())
+		return const_iterator(*this,f,base_data.lower_bound(key));
+	data_type::const_iterator g=base_data.find(key);
+	if (g==base_data.end()) return end();
+	return const_iterator(*this,_data.lower_bound(key),g);
 }
 
 void status_table::insert(const key_type& key,const mapped_type& value)
 {
+	data_type::size_type size=_data.size();
 	_data[key]=value;
-	notify();
+	if (_data.size()!=size) ++_generation;
+	notify(key);
 }
 
 void status_table::insert(const status_table& table)
 {
+	batch b(*this);
 	for (const_iterator i=table.begin();i!=table.end();++i)
 	{
-		_data[i->first]=i->second;
+		insert(i->first,i->second);
 	}
-	notify();
 }
 
 void status_table::clear()
 {
 	_data.clear();
+	_base=0;
+	++_generation;
 	notify();
 }
 
@@ -70,40 +97,16 @@ void status_table::commit()
 	// Take no action unless a pathname has been specified.
 	if (_pathname.size())
 	{
-		// Set pathnames.
-		string dst_pathname=_pathname;
-		string tmp_pathname=_pathname+string("++");
-		string bak_pathname=_pathname+string("--");
-	
-		// Write new status file.
+		// Write new status file, then move it into place.
 		static mapped_type default_value;
-		std::ofstream out(tmp_pathname.c_str());
-		for (const_iterator i=_data.begin();i!=_data.end();++i)
+		commit_writer writer(_pathname);
+		std::ostream& out=writer.out();
+		for (const_iterator i=begin();i!=end();++i)
 		{
 			if (i->second!=default_value)
-				out << *i << std::endl;
-		}
-		out.close();
-		if (!out) throw commit_error();
-	
-		try
-		{
-			// Backup existing status file if it exists.
-			if (object_type(dst_pathname)!=0)
-			{
-				force_move(dst_pathname,bak_pathname,true);
-			}
-		
-			// Move new status file to destination.
-			force_move(tmp_pathname,dst_pathname,false);
-		
-			// Delete backup.
-			force_delete(bak_pathname);
-		}
-		catch (...)
-		{
-			throw commit_error();
+				out << *i << '\n';
 		}
+		if (!writer.commit()) throw commit_error();
 	}
 }
 
@@ -115,6 +118,12 @@ void status_table::rollback()
 		_data.clear();
 		bool done=read(_pathname);
 		if (!done) read(_pathname+string("--"));
+		++_generation;
+	}
+	else if (_base)
+	{
+		_data.clear();
+		++_generation;
 	}
 }
 
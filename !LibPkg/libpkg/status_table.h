@@ -17,6 +17,7 @@
 #ifndef LIBPKG_STATUS_TABLE
 #define LIBPKG_STATUS_TABLE
 
+#include <iterator>
 #include <map>
 #include <string>
 
@@ -27,28 +28,61 @@ namespace pkg {
 
 using std::string;
 
-/** A class for mapping package name to package status. */
+/** A class for mapping package name to package status.
+ * A status table may be constructed as an overlay on another table,
+ * in which case it initially has the same content as that table but
+ * records only those packages which have been set since.  Changes made
+ * to the overlay are not visible through the underlying table, which
+ * allows (for example) the effect of a set of changes to be worked out
+ * without disturbing the table that the rest of the program sees.
+ * There is only one level of overlay: an overlay cannot be constructed
+ * on another overlay.
+ */
 class status_table:
 	public table
 {
 public:
 	typedef string key_type;
 	typedef status mapped_type;
-	typedef std::map<key_type,mapped_type>::const_iterator const_iterator;
+	class const_iterator;
 	class commit_error;
 private:
+	typedef std::map<key_type,mapped_type> data_type;
+
 	/** The pathname of the underlying status file,
 	 * or the empty string if none. */
 	string _pathname;
 
-	/** A map from package name to package status. */
-	std::map<key_type,mapped_type> _data;
+	/** The table on which this one is overlaid, or 0 if none. */
+	const status_table* _base;
+
+	/** A map from package name to package status.
+	 * For an overlay this contains only those packages which have been
+	 * set since the overlay was constructed.
+	 */
+	data_type _data;
+
+	/** A count which changes whenever a package is added to or removed
+	 * from _data.  Overlay iterators use it to detect when they must
+	 * re-establish their position.
+	 */
+	unsigned int _generation;
 public:
 	/** Construct status table.
 	 * @param pathname the pathname of the underlying status file
 	 */
 	status_table(const string& pathname=string());
 
+	/** Construct overlay on status table.
+	 * Changes to the underlying table remain visible through the overlay
+	 * for any package which has not been set in the overlay itself.
+	 * The underlying table must outlive the overlay, and must not itself
+	 * be an overlay.
+	 * @param base the table on which the overlay is to be constructed
+	 * @throws std::invalid_argument if the underlying table is an overlay
+	 */
+	explicit status_table(const status_table* base);
+
 	/** Destroy status table. */
 	virtual ~status_table();
 
@@ -62,14 +96,12 @@ public:
 	/** Get const iterator for start of table.
 	 * @return the const iterator
 	 */
-	const_iterator begin() const
-		{ return _data.begin(); }
+	const_iterator begin() const;
 
 	/** Get const iterator for end of table.
 	 * @return the const iterator
 	 */
-	const_iterator end() const
-		{ return _data.end(); }
+	const_iterator end() const;
 
 	/** Find const iterator for package.
 	 * @param key the package name
@@ -90,9 +122,18 @@ public:
 	 */
 	void insert(const status_table& table);
 
-	/** Clear status of all packages. */
+	/** Clear status of all packages.
+	 * If this table is an overlay then it is detached from the
+	 * underlying table.
+	 */
 	void clear();
 
+	/** Get the table on which this one is overlaid.
+	 * @return the underlying table, or 0 if this is not an overlay
+	 */
+	const status_table* base() const
+		{ return _base; }
+
 	/** Commit changes.
 	 * Any changes since the last call to commit() or rollback() are
 	 * committed to disc.
@@ -101,10 +142,18 @@ public:
 
 	/** Roll back changes.
 	 * Any changes since the last call to commit() or rollback() are
-	 * discarded.
+	 * discarded.  For an overlay without an underlying status file this
+	 * discards any packages that have been set in the overlay.
 	 */
 	void rollback();
 private:
+	/** Get the combined generation of this table and the table on
+	 * which it is overlaid.
+	 * @return the generation
+	 */
+	unsigned int generation() const
+		{ return (_base)?_generation+_base->_generation:_generation; }
+
 	/** Read status file.
 	 * @param pathname the pathname of the status file
 	 * @return true if the file was found, otherwise false
@@ -112,6 +161,199 @@ private:
 	bool read(const string& pathname);
 };
 
+/** A const iterator class for status tables.
+ * This is a bidirectional iterator.  For a table that is not an overlay
+ * it steps through the underlying map.  For an overlay it steps through
+ * the union of the packages set in the overlay and those in the
+ * underlying table, in order of package name, with the overlay taking
+ * precedence.  The iterator remains valid if packages are set in either
+ * table while it is in use: its position is re-established from the
+ * current package name when it is next moved, if (and only if) a
+ * package has been added to either table since it was last moved.
+ */
+class status_table::const_iterator:
+	public std::iterator<std::bidirectional_iterator_tag,
+		const std::pair<const key_type,mapped_type> >
+{
+private:
+	/** The table. */
+	const status_table* _table;
+
+	/** The current position within the packages set in the table.
+	 * For an overlay this is the first package not before the current
+	 * one.
+	 */
+	data_type::const_iterator _pos;
+
+	/** The first package in the underlying table not before the
+	 * current one, if the table is an overlay. */
+	data_type::const_iterator _base_pos;
+
+	/** The generations of the table and the underlying table when
+	 * the positions were last established, if the table is an overlay. */
+	unsigned int _generation;
+public:
+	/** Construct singular const iterator. */
+	const_iterator():
+		_table(0),
+		_generation(0)
+	{}
+
+	/** Construct const iterator.
+	 * @param table the table
+	 * @param pos the position within the packages set in the table
+	 * @param base_pos the position within the underlying table, if
+	 *  the table is an overlay
+	 */
+	const_iterator(const status_table& table,data_type::const_iterator pos,
+		data_type::const_iterator base_pos=data_type::const_iterator()):
+		_table(&table),
+		_pos(pos),
+		_base_pos(base_pos),
+		_generation(table.generation())
+	{}
+
+	/** Dereference iterator.
+	 * @return the current package name and status
+	 */
+	reference operator*() const
+		{ return (_table->_base&&from_base())?*_base_pos:*_pos; }
+
+	/** Dereference iterator.
+	 * @return a pointer to the current package name and status
+	 */
+	pointer operator->() const
+		{ return &**this; }
+
+	/** Pre-increment iterator.
+	 * @return a reference to this
+	 */
+	const_iterator& operator++()
+	{
+		if (_table->_base)
+		{
+			sync();
+			const key_type& key=(**this).first;
+			if ((_base_pos!=_table->_base->_data.end())&&
+				(_base_pos->first==key)) ++_base_pos;
+			if ((_pos!=_table->_data.end())&&(_pos->first==key)) ++_pos;
+		}
+		else ++_pos;
+		return *this;
+	}
+
+	/** Post-increment iterator.
+	 * @return a copy of this before it was incremented
+	 */
+	const_iterator operator++(int)
+	{
+		const_iterator prev(*this);
+		++*this;
+		return prev;
+	}
+
+	/** Pre-decrement iterator.
+	 * @return a reference to this
+	 */
+	const_iterator& operator--()
+	{
+		if (_table->_base)
+		{
+			// Step back to whichever of the preceding packages in the
+			// two tables comes later, or both if they are the same.
+			sync();
+			bool data_first=(_pos==_table->_data.begin());
+			bool base_first=(_base_pos==_table->_base->_data.begin());
+			data_type::const_iterator prev_pos=_pos;
+			data_type::const_iterator prev_base_pos=_base_pos;
+			if (!data_first) --prev_pos;
+			if (!base_first) --prev_base_pos;
+			if (data_first||(!base_first&&
+				(prev_pos->first<prev_base_pos->first)))
+			{
+				_base_pos=prev_base_pos;
+			}
+			else if (base_first||
+				(prev_base_pos->first<prev_pos->first))
+			{
+				_pos=prev_pos;
+			}
+			else
+			{
+				_pos=prev_pos;
+				_base_pos=prev_base_pos;
+			}
+		}
+		else --_pos;
+		return *this;
+	}
+
+	/** Post-decrement iterator.
+	 * @return a copy of this before it was decremented
+	 */
+	const_iterator operator--(int)
+	{
+		const_iterator prev(*this);
+		--*this;
+		return prev;
+	}
+
+	/** Compare iterators for equality.
+	 * @param that the iterator to compare with
+	 * @return true if equal, otherwise false
+	 */
+	bool operator==(const const_iterator& that) const
+		{ return (_pos==that._pos)&&(!_table->_base||(_base_pos==that._base_pos)); }
+
+	/** Compare iterators for inequality.
+	 * @param that the iterator to compare with
+	 * @return true if not equal, otherwise false
+	 */
+	bool operator!=(const const_iterator& that) const
+		{ return !(*this==that); }
+private:
+	/** Test whether the current package comes from the underlying table.
+	 * @return true if from the underlying table, false if from this one
+	 */
+	bool from_base() const
+	{
+		return (_pos==_table->_data.end())||
+			((_base_pos!=_table->_base->_data.end())&&
+			(_base_pos->first<_pos->first));
+	}
+
+	/** Re-establish the positions within an overlay and its underlying
+	 * table, if a package has been added to either since they were
+	 * last established.
+	 */
+	void sync()
+	{
+		unsigned int generation=_table->generation();
+		if (generation==_generation) return;
+		_generation=generation;
+		const data_type& base_data=_table->_base->_data;
+		if ((_pos==_table->_data.end())&&(_base_pos==base_data.end()))
+			return;
+		key_type key=(**this).first;
+		_pos=_table->_data.lower_bound(key);
+		_base_pos=base_data.lower_bound(key);
+	}
+};
+
+inline status_table::const_iterator status_table::begin() const
+{
+	return (_base)?
+		const_iterator(*this,_data.begin(),_base->_data.begin()):
+		const_iterator(*this,_data.begin());
+}
+
+inline status_table::const_iterator status_table::end() const
+{
+	return (_base)?
+		const_iterator(*this,_data.end(),_base->_data.end()):
+		const_iterator(*this,_data.end());
+}
+
 /** An exception class for reporting failure to commit table. */
 class status_table::commit_error:
 	public std::runtime_error
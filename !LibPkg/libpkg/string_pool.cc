@@ -0,0 +1,62 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libpkg/string_pool.h"
+
+namespace pkg {
+
+string_pool::string_pool()
+{}
+
+string_pool::~string_pool()
+{}
+
+const shared_string& string_pool::intern(const string& value)
+{
+	auto f=_strings.find(&value);
+	if (f!=_strings.end()) return f->second;
+	shared_string interned(value);
+	return _strings.insert(std::make_pair(&interned.str(),interned))
+		.first->second;
+}
+
+const shared_string& string_pool::intern(const shared_string& value)
+{
+	auto f=_strings.find(&value.str());
+	if (f!=_strings.end()) return f->second;
+	return _strings.insert(std::make_pair(&value.str(),value))
+		.first->second;
+}
+
+void string_pool::clear()
+{
+	_strings.clear();
+}
+
+unsigned long string_pool::bytes_saved() const
+{
+	// One reference to each value is held by the pool itself.
+	unsigned long saved=0;
+	for (auto i=_strings.begin();i!=_strings.end();++i)
+	{
+		long count=i->second.use_count();
+		if (count>2) saved+=(count-2)*i->second.size();
+	}
+	return saved;
+}
+
+}; /* namespace pkg */
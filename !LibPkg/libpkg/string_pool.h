@@ -0,0 +1,124 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_STRING_POOL
+#define LIBPKG_STRING_POOL
+
+#include <unordered_map>
+#include <string>
+
+#include "libpkg/shared_string.h"
+
+namespace pkg {
+
+using std::string;
+
+/** A class for sharing repeated string values.
+ * Each distinct value is held once by the pool, and interning a value
+ * returns a shared string that refers to that copy.  Any number of
+ * records can then hold the value without copying its characters, and
+ * two interned values can be compared by identity rather than by
+ * content.
+ */
+class string_pool
+{
+private:
+	/** A class for hashing the value to which a pointer refers. */
+	class hash_value
+	{
+	public:
+		std::size_t operator()(const string* value) const
+			{ return std::hash<string>()(*value); }
+	};
+
+	/** A class for comparing the values to which pointers refer. */
+	class equal_value
+	{
+	public:
+		bool operator()(const string* lhs,const string* rhs) const
+			{ return *lhs==*rhs; }
+	};
+
+	/** A map from value to the shared string which holds it.
+	 * Each key points to the value held by its shared string, so that
+	 * a value can be looked up without being copied.
+	 */
+	std::unordered_map<const string*,shared_string,hash_value,equal_value>
+		_strings;
+public:
+	/** Construct string pool. */
+	string_pool();
+
+	/** Destroy string pool. */
+	~string_pool();
+
+	/** Intern value.
+	 * @param value the value to be interned
+	 * @return the shared string held by the pool
+	 */
+	const shared_string& intern(const string& value);
+
+	/** Intern shared string.
+	 * If the value is not already present then the pool shares the
+	 * storage of the given shared string, so no characters are copied.
+	 * @param value the value to be interned
+	 * @return the shared string held by the pool
+	 */
+	const shared_string& intern(const shared_string& value);
+
+	/** Remove all values from the pool.
+	 * Shared strings obtained from the pool remain valid.
+	 */
+	void clear();
+
+	/** Get number of distinct values held by the pool.
+	 * @return the number of values
+	 */
+	unsigned int size() const
+		{ return _strings.size(); }
+
+	/** Get number of bytes saved by interning.
+	 * This is calculated from the values that are currently shared: for
+	 * each value held by the pool, its length is counted once for every
+	 * shared string other than the first that refers to it outside the
+	 * pool.  It takes time proportional to the size of the pool.
+	 * @return the number of bytes saved
+	 */
+	unsigned long bytes_saved() const;
+
+	/** Test whether two shared strings share storage.
+	 * This takes constant time.  Non-empty values interned by the same
+	 * pool share storage if and only if they are equal.
+	 * @param lhs the left hand side
+	 * @param rhs the right hand side
+	 * @return true if lhs and rhs share storage, otherwise false
+	 */
+	static bool identical(const shared_string& lhs,const shared_string& rhs)
+		{ return lhs.identical(rhs); }
+
+	/** Compare two shared strings, using identity where possible.
+	 * @param lhs the left hand side
+	 * @param rhs the right hand side
+	 * @return true if lhs==rhs, otherwise false
+	 */
+	static bool equal(const shared_string& lhs,const shared_string& rhs)
+		{ return identical(lhs,rhs)||(lhs.str()==rhs.str()); }
+};
+
+}; /* namespace pkg */
+
+#endif
@@ -14,11 +14,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <exception>
+
 #include "libpkg/table.h"
 
 namespace pkg {
 
-table::table()
+table::table():
+	_update_depth(0),
+	_update_changed(false),
+	_update_all(false)
 {}
 
 table::~table()
@@ -39,8 +44,35 @@ void table::deregister_watcher(watcher& w)
 	_watchers.erase(&w);
 }
 
+void table::begin_update()
+{
+	++_update_depth;
+}
+
+void table::end_update()
+{
+	if (_update_depth&&!--_update_depth&&_update_changed)
+	{
+		bool all=_update_all;
+		std::set<std::string> keys;
+		keys.swap(_update_keys);
+		_update_changed=false;
+		_update_all=false;
+		if (all) notify();
+		else notify(keys);
+	}
+}
+
 void table::notify()
 {
+	if (_update_depth)
+	{
+		_update_changed=true;
+		_update_all=true;
+		_update_keys.clear();
+		return;
+	}
+
 	for (std::set<watcher*>::const_iterator i=_watchers.begin();
 		i!=_watchers.end();++i)
 	{
@@ -48,6 +80,49 @@ void table::notify()
 	}
 }
 
+void table::notify(const std::string& key)
+{
+	if (_update_depth)
+	{
+		_update_changed=true;
+		if (!_update_all) _update_keys.insert(key);
+		return;
+	}
+
+	std::set<std::string> keys;
+	keys.insert(key);
+	notify(keys);
+}
+
+void table::notify(const std::set<std::string>& keys)
+{
+	for (std::set<watcher*>::const_iterator i=_watchers.begin();
+		i!=_watchers.end();++i)
+	{
+		(*i)->handle_change(*this,keys);
+	}
+}
+
+table::batch::batch(table& t):
+	_table(t)
+{
+	_table.begin_update();
+}
+
+table::batch::~batch() noexcept(false)
+{
+	if (std::uncaught_exception())
+	{
+		try
+		{
+			_table.end_update();
+		}
+		catch (...)
+		{}
+	}
+	else _table.end_update();
+}
+
 table::watcher::watcher()
 {}
 
@@ -72,4 +147,10 @@ void table::watcher::unwatch(table& t)
 	t.deregister_watcher(*this);
 }
 
+void table::watcher::handle_change(table& t,
+	const std::set<std::string>& keys)
+{
+	handle_change(t);
+}
+
 }; /* namespace pkg */
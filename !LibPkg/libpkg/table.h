@@ -18,6 +18,7 @@
 #define LIBPKG_TABLE
 
 #include <set>
+#include <string>
 
 namespace pkg {
 
@@ -25,24 +26,77 @@ namespace pkg {
  * The base class does not provide any access to the content of the
  * table.  It does implement the notification mechanism, whereby other
  * objects can be informed when the content has changed.
+ *
+ * A table may say which entries have changed by giving their keys.
+ * Watchers that can make use of this are told the keys, and others are
+ * simply told that the table has changed.
+ *
+ * A sequence of changes can be grouped into an update, during which
+ * notification is deferred.  Watchers are then notified once when the
+ * outermost update ends, provided that something has changed.  The keys
+ * of the changes are merged, unless there was a change for which no key
+ * was given.
  */
 class table
 {
 public:
 	class watcher;
+	class batch;
 	friend class watcher;
 private:
 	/** The set of currently registered watchers. */
 	std::set<watcher*> _watchers;
+
+	/** The number of updates that have begun but not ended. */
+	unsigned int _update_depth;
+
+	/** True if a change has occurred during the current update,
+	 * otherwise false. */
+	bool _update_changed;
+
+	/** True if a change for which no key was given has occurred during
+	 * the current update, otherwise false. */
+	bool _update_all;
+
+	/** The keys of the entries that have changed during the current
+	 * update. */
+	std::set<std::string> _update_keys;
 public:
 	/** Construct table. */
 	table();
 
 	/** Destroy table. */
 	virtual ~table();
+
+	/** Begin update.
+	 * Watchers are not notified of changes until the matching call
+	 * to end_update().  Updates may be nested.
+	 */
+	void begin_update();
+
+	/** End update.
+	 * If this ends the outermost update, and if there were changes
+	 * during the update, then watchers are notified once.
+	 */
+	void end_update();
 protected:
-	/** Notify watchers that a change has occurred. */
+	/** Notify watchers that a change has occurred.
+	 * If an update is in progress then notification is deferred until
+	 * it ends.
+	 */
 	void notify();
+
+	/** Notify watchers that the entries with a given key have changed.
+	 * If an update is in progress then notification is deferred until
+	 * it ends.
+	 * @param key the key of the entries that have changed
+	 */
+	void notify(const std::string& key);
+private:
+	/** Notify watchers that the entries with given keys have changed.
+	 * @param keys the keys of the entries that have changed
+	 */
+	void notify(const std::set<std::string>& keys);
 private:
 	/** Register a watcher.
 	 * This can only be done by the watcher in question (which is then
@@ -58,6 +112,33 @@ private:
 	void deregister_watcher(watcher& w);
 };
 
+/** A class for grouping changes to a table into one update.
+ * The update begins when the batch is constructed and ends when it is
+ * destroyed.  If the batch is destroyed because an exception has been
+ * thrown then watchers are still notified, but any exception thrown by
+ * a watcher is discarded.
+ */
+class table::batch
+{
+private:
+	/** The table being updated. */
+	table& _table;
+public:
+	/** Construct batch.
+	 * @param t the table to be updated
+	 */
+	batch(table& t);
+
+	/** Destroy batch. */
+	~batch() noexcept(false);
+private:
+	/** Prevent copying. */
+	batch(const batch&);
+
+	/** Prevent assignment. */
+	batch& operator=(const batch&);
+};
+
 /** A mixin class to allow an object to watch one or more tables. */
 class table::watcher
 {
@@ -85,6 +166,13 @@ public:
 	 * @param t the table that has changed
 	 */
 	virtual void handle_change(table& t)=0;
+
+	/** Handle change to given entries of table.
+	 * By default this is handled as a change to the whole table.
+	 * @param t the table that has changed
+	 * @param keys the keys of the entries that have changed
+	 */
+	virtual void handle_change(table& t,const std::set<std::string>& keys);
 };
 
 }; /* namespace pkg */
@@ -0,0 +1,104 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+
+#include "libpkg/transaction_plan.h"
+
+namespace pkg {
+
+namespace {
+
+/** Get a size field from a control record.
+ * @param ctrl the control record
+ * @param field the field
+ * @return the value of the field, or 0 if it is absent
+ */
+transaction_plan::size_type size_field(const control& ctrl,
+	control::field_type field)
+{
+	control::const_iterator f=ctrl.find(field);
+	if (f==ctrl.end()) return 0;
+	return std::strtoull(f->second.c_str(),0,10);
+}
+
+/** Get the control record for a package status.
+ * @param control the binary control table
+ * @param pkgname the package name
+ * @param pkgstat the package status
+ * @return the control record
+ */
+const binary_control& find_control(const binary_control_table& control,
+	const string& pkgname,const status& pkgstat)
+{
+	binary_control_table::key_type key(pkgname,pkgstat.version(),
+		pkgstat.environment_id());
+	return control[key];
+}
+
+}; /* anonymous namespace */
+
+transaction_plan::transaction_plan(const status_table& curstat,
+	const status_table& selstat,const binary_control_table& control):
+	_download_size(0),
+	_unpacked_size(0),
+	_removed_size(0)
+{
+	// Step through the union of the two tables in order of package
+	// name.  A package missing from either table has the default status.
+	static const status default_status;
+	status_table::const_iterator i=curstat.begin();
+	status_table::const_iterator j=selstat.begin();
+	while ((i!=curstat.end())||(j!=selstat.end()))
+	{
+		bool in_cur=(i!=curstat.end())&&
+			((j==selstat.end())||!(j->first<i->first));
+		bool in_sel=(j!=selstat.end())&&
+			((i==curstat.end())||!(i->first<j->first));
+		const string& pkgname=(in_cur)?i->first:j->first;
+		const status& cur=(in_cur)?i->second:default_status;
+		const status& sel=(in_sel)?j->second:default_status;
+
+		if (unpack_req(cur,sel))
+		{
+			const binary_control& ctrl=find_control(control,pkgname,sel);
+			_download_size+=size_field(ctrl,control::field_size);
+			_unpacked_size+=size_field(ctrl,control::field_installed_size);
+			if (cur.state()<status::state_unpacked)
+			{
+				_install.push_back(pkgname);
+			}
+			else
+			{
+				_upgrade.push_back(pkgname);
+				_removed_size+=size_field(find_control(control,pkgname,cur),
+					control::field_installed_size);
+			}
+		}
+		else if (remove_req(cur,sel))
+		{
+			_remove.push_back(pkgname);
+			_removed_size+=size_field(find_control(control,pkgname,cur),
+				control::field_installed_size);
+		}
+
+		if (in_cur) ++i;
+		if (in_sel) ++j;
+	}
+}
+
+}; /* namespace pkg */
@@ -0,0 +1,131 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_TRANSACTION_PLAN
+#define LIBPKG_TRANSACTION_PLAN
+
+#include <string>
+#include <vector>
+
+#include "libpkg/status_table.h"
+#include "libpkg/binary_control_table.h"
+
+namespace pkg {
+
+using std::string;
+
+/** A class for summarising the changes needed to reach a selection.
+ * The plan compares a current status table with a selected status table
+ * (typically an overlay on which dependencies have been fixed) and lists
+ * the packages that a commit would install, upgrade or remove, together
+ * with the amount that would have to be downloaded and unpacked.
+ * Neither table is modified.
+ *
+ * Sizes are taken from the Size and Installed-Size fields of the binary
+ * control table.  A package for which the relevant field is absent does
+ * not contribute to the total.  No account is taken of packages that
+ * are already in the cache, so the download size is an upper bound.
+ */
+class transaction_plan
+{
+public:
+	/** A type for representing sizes in bytes. */
+	typedef unsigned long long size_type;
+private:
+	/** The packages to be installed, in order of package name. */
+	std::vector<string> _install;
+
+	/** The packages to be upgraded (or otherwise replaced by a different
+	 * version), in order of package name. */
+	std::vector<string> _upgrade;
+
+	/** The packages to be removed, in order of package name. */
+	std::vector<string> _remove;
+
+	/** The total size of the packages to be downloaded. */
+	size_type _download_size;
+
+	/** The total installed size of the packages to be unpacked. */
+	size_type _unpacked_size;
+
+	/** The total installed size of the packages to be removed,
+	 * including the current versions of packages to be upgraded. */
+	size_type _removed_size;
+public:
+	/** Construct transaction plan.
+	 * @param curstat the current status table
+	 * @param selstat the selected status table
+	 * @param control the binary control table
+	 */
+	transaction_plan(const status_table& curstat,const status_table& selstat,
+		const binary_control_table& control);
+
+	/** Get the packages to be installed.
+	 * These are packages which are to be unpacked, and which are not
+	 * currently unpacked.
+	 * @return the package names
+	 */
+	const std::vector<string>& install() const
+		{ return _install; }
+
+	/** Get the packages to be upgraded.
+	 * These are packages which are to be unpacked, and of which a
+	 * different version or environment is currently unpacked.
+	 * @return the package names
+	 */
+	const std::vector<string>& upgrade() const
+		{ return _upgrade; }
+
+	/** Get the packages to be removed.
+	 * These are packages which are currently unpacked and are not to
+	 * be replaced by another version.
+	 * @return the package names
+	 */
+	const std::vector<string>& remove() const
+		{ return _remove; }
+
+	/** Test whether the plan is empty.
+	 * @return true if no packages are to be installed, upgraded or
+	 *  removed, otherwise false
+	 */
+	bool empty() const
+		{ return _install.empty()&&_upgrade.empty()&&_remove.empty(); }
+
+	/** Get the amount to be downloaded.
+	 * @return the total size of the packages to be installed or upgraded
+	 */
+	size_type download_size() const
+		{ return _download_size; }
+
+	/** Get the amount to be unpacked.
+	 * @return the total installed size of the packages to be installed
+	 *  or upgraded
+	 */
+	size_type unpacked_size() const
+		{ return _unpacked_size; }
+
+	/** Get the amount to be removed.
+	 * @return the total installed size of the packages to be removed,
+	 *  and of the versions to be replaced by those to be upgraded
+	 */
+	size_type removed_size() const
+		{ return _removed_size; }
+};
+
+}; /* namespace pkg */
+
+#endif
@@ -1810,6 +1810,12 @@ bool unpack::already_installed(const control& ctrl, const std::set<string> &mf)
 
 void unpack::update_existing_modules()
 {
+	// Group the changes to the control and status tables so that their
+	// watchers are notified once, rather than once for each package.
+	table::batch control_batch(_pb.control());
+	table::batch curstat_batch(_pb.curstat());
+	bool control_changed=false;
+
  	for (std::set<string>::iterator i = _existing_module_packages.begin();
  		   i != _existing_module_packages.end(); ++i)
  	{
@@ -1840,7 +1846,7 @@ void unpack::update_existing_modules()
 			{
 			  // Update main list
 			  _pb.control().insert(new_control);
-			  _pb.control().commit();
+			  control_changed=true;
 
 			 	// Mark package as installed with the module version
 				status curstat=_pb.curstat()[pkgname];
@@ -1858,6 +1864,18 @@ void unpack::update_existing_modules()
 		  if (_log) _log->message(LOG_WARNING_MODULE_PACKAGE_UPDATE_FAILED, e.what());
 		}
 	}
+
+	// Commit the main list once all of the packages have been updated.
+	if (control_changed)
+	{
+		try
+		{
+			_pb.control().commit();
+		} catch(std::exception &e)
+		{
+			if (_log) _log->message(LOG_WARNING_MODULE_PACKAGE_UPDATE_FAILED, e.what());
+		}
+	}
 	_existing_module_packages.clear();
 }
 
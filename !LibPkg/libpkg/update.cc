@@ -19,6 +19,8 @@
 #include "libpkg/version.h"
 #include "libpkg/status.h"
 #include "libpkg/binary_control.h"
+#include "libpkg/control_cursor.h"
+#include "libpkg/env_checker.h"
 #include "libpkg/pkgbase.h"
 #include "libpkg/download.h"
 #include "libpkg/update.h"
@@ -143,41 +145,90 @@ void update::_poll()
 			_url=*_sources_to_build.begin();
 			if (_log) _log->message(LOG_INFO_ADDING_AVAILABLE, _url);
 			string pathname=_pb.list_pathname(_url);
-			std::ifstream in(pathname.c_str());
+			string buffer;
+			read_file(pathname,buffer);
 
 			// Absorb any spaces at beginning of file - some package list
 			// were including extra linefeeds at the beginning
-			while (in && !in.eof() && isspace(in.peek())) in.get();
+			string::const_iterator first=buffer.begin();
+			while ((first!=buffer.end())&&isspace(*first)) ++first;
 
-			while (in&&!in.eof())
+			// Copy each record to the available list without building
+			// a control object for it.  Only the fields needed to
+			// identify the package are decoded, and only the URL field
+			// is rewritten.  Records are checked for syntax errors and
+			// duplicate fields as they would be by parse_control(), so
+			// that a malformed list is rejected here rather than when
+			// the available list is next read.
+			control_cursor cursor(first,buffer.end());
+			field_name_set names;
+			while (cursor.next_record())
 			{
-				// Read control record from source.
-				binary_control ctrl;
-				in >> ctrl;
-
-				// Convert relative URL to absolute.
-				if (ctrl.find("URL")!=ctrl.end())
+				names.clear();
+				string pkgname;
+				string pkgvrsn;
+				string environment;
+				string osdepends;
+				string url;
+				string::const_iterator url_first=cursor.record_end();
+				string::const_iterator url_name_last=cursor.record_end();
+				string::const_iterator url_last=cursor.record_end();
+				bool has_url=false;
+				while (cursor.next_field())
 				{
-					uri base_url(_url);
-					uri rel_url(ctrl["URL"]);
-					uri abs_url=base_url+rel_url;
-					ctrl["URL"]=abs_url;
+					if (!names.insert(cursor))
+						throw control::parse_error("duplicate field name");
+					switch (cursor.field())
+					{
+					case control::field_package:
+						pkgname=cursor.value();
+						break;
+					case control::field_version:
+						pkgvrsn=cursor.value();
+						break;
+					case control::field_environment:
+						environment=cursor.value();
+						break;
+					case control::field_osdepends:
+						osdepends=cursor.value();
+						break;
+					case control::field_url:
+						url=cursor.value();
+						url_first=cursor.field_begin();
+						url_name_last=cursor.name_end();
+						url_last=cursor.field_end();
+						has_url=true;
+						break;
+					default:
+						break;
+					}
 				}
 
 				// Extract package name and version.
-				string pkgname=ctrl.pkgname();
-				version pkgvrsn=ctrl.version();
-				binary_control_table::key_type key(pkgname,pkgvrsn,ctrl.environment_id());
+				string envid=env_checker::instance()->
+					package_env(environment,osdepends)->id();
+				binary_control_table::key_type key(pkgname,pkgvrsn,envid);
 				if (_packages_written.find(key)==_packages_written.end())
 				{
-					// If not already written then write to available list.
-					if (_packages_written.size()) (*_out) << std::endl;
-					(*_out) << ctrl;
+					// If not already written then write to available list,
+					// converting any relative URL to an absolute one.
+					std::ostream& out=*_out;
+					if (_packages_written.size()) out << '\n';
+					out.write(&*cursor.record_begin(),
+						url_first-cursor.record_begin());
+					if (has_url)
+					{
+						uri base_url(_url);
+						uri rel_url(url);
+						uri abs_url=base_url+rel_url;
+						out << string(url_first,url_name_last) << ": "
+							<< string(abs_url);
+					}
+					if (url_last!=cursor.record_end())
+						out.write(&*url_last,cursor.record_end()-url_last);
+					out << '\n';
 					_packages_written.insert(key);
 				}
-
-				// Absorb newlines between packages.
-				while (in.peek()=='\n') in.get();
 			}
 			_sources_to_build.erase(_url);
 		}
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include <ctype.h>
+#include <string.h>
 
 #include "libpkg/version.h"
 
@@ -59,19 +60,15 @@ static inline int cmp_char(char lhs,char rhs)
  * The sort order is by ASCII character code, modified so that letters
  * sort earlier than non-letters, and so that a tilde sorts earlier than
  * anything (including the empty string).
- * @param lfirst the start of the left hand side
+ * @param lp the start of the left hand side
  * @param llast the end of the left hand side
- * @param rfirst the start of the right hand side
+ * @param rp the start of the right hand side
  * @param rlast the end of the right hand side
  * @return 0 if lhs==rhs, +1 if lhs>rhs or -1 if lhs<rhs
  */
-static int cmp_lex(string::const_iterator lfirst,string::const_iterator llast,
-	string::const_iterator rfirst,string::const_iterator rlast)
+static inline int cmp_lex(const char* lp,const char* llast,
+	const char* rp,const char* rlast)
 {
-	// Initialise iterators.
-	string::const_iterator lp=lfirst;
-	string::const_iterator rp=rfirst;
-
 	// Skip matching characters.
 	while ((lp!=llast)&&(rp!=rlast)&&(*lp==*rp))
 	{
@@ -86,120 +83,59 @@ static int cmp_lex(string::const_iterator lfirst,string::const_iterator llast,
 	return cmp_char(lc,rc);
 }
 
-/** Numerically compare two character sequences.
- * Both sequences must be composed entirely of digits for the result
- * to be meaningful.
- * @param lfirst the start of the left hand side
- * @param llast the end of the left hand side
- * @param rfirst the start of the right hand side
- * @param rlast the end of the right hand side
- * @return 0 if lhs==rhs, +1 if lhs>rhs or -1 if lhs<rhs
- */
-static int cmp_num(string::const_iterator lfirst,string::const_iterator llast,
-	string::const_iterator rfirst,string::const_iterator rlast)
+int version::compare_num(const char* lstr,const segment& lseg,
+	const char* rstr,const segment& rseg)
 {
-	// Initialise iterators.
-	string::const_iterator lp=lfirst;
-	string::const_iterator rp=rfirst;
-
-	// Skip leading zeros.
-	while ((lp!=llast)&&(*lp=='0')) ++lp;
-	while ((rp!=rlast)&&(*rp=='0')) ++rp;
-
-	// Compare by length if there is a difference,
-	// otherwise compare by first non-matching digit.
-	int llen=llast-lp;
-	int rlen=rlast-rp;
+	// Leading zeros have already been skipped, so compare by length
+	// if there is a difference.
+	unsigned int llen=lseg.num_last-lseg.num_first;
+	unsigned int rlen=rseg.num_last-rseg.num_first;
 	if (llen!=rlen)
 	{
 		if (llen<rlen) return -1;
 		else return +1;
 	}
-	else
-	{
-		while ((lp!=llast)&&(*lp==*rp))
-		{
-			++lp;
-			++rp;
-		}
-		if (lp!=llast)
-		{
-			if (*lp<*rp) return -1;
-			else return +1;
-		}
-		else return 0;
-	}
-}
 
-/** Compare two epochs.
- * @param lhs the left hand side
- * @param rhs the right hand side
- * @return 0 if lhs==rhs, +1 if lhs>rhs or -1 if lhs<rhs
- */
-static int cmp_epoch(const string& lhs,const string& rhs)
-{
-	return cmp_num(lhs.begin(),lhs.end(),rhs.begin(),rhs.end());
+	// Otherwise compare by first non-matching digit.
+	int cmp=memcmp(lstr+lseg.num_first,rstr+rseg.num_first,llen);
+	if (cmp<0) return -1;
+	else if (cmp>0) return +1;
+	else return 0;
 }
 
-/** Compare two upstream versions or package versions.
- * @param lhs the left hand side
- * @param rhs the right hand side
- * @return 0 if lhs==rhs, +1 if lhs>rhs or -1 if lhs<rhs
- */
-static int cmp_verstr(const string& lhs,const string& rhs)
+int version::compare_segments(const char* lstr,const segment* lfirst,
+	const segment* llast,const char* rstr,const segment* rfirst,
+	const segment* rlast)
 {
-	// Initialise iterators.
-	string::const_iterator lrm=lhs.end();
-	string::const_iterator rrm=rhs.end();
-	string::const_iterator lp=lhs.begin();
-	string::const_iterator rp=rhs.begin();
-
-	// Compare non-numeric then numeric segments alternately.
-	while ((lp!=lrm)||(rp!=rrm))
+	static const segment empty={0,0,0,0};
+
+	// Compare non-numeric then numeric parts alternately.
+	while ((lfirst!=llast)||(rfirst!=rlast))
 	{
-		// Compare non-numeric segment.
-		string::const_iterator lq=lp;
-		string::const_iterator rq=rp;
-		while ((lp!=lrm)&&!isdigit(*lp)) ++lp;
-		while ((rp!=rrm)&&!isdigit(*rp)) ++rp;
-		if (int cmp=cmp_lex(lq,lp,rq,rp)) return cmp;
-
-		// Compare numeric segment
-		string::const_iterator lr=lp;
-		string::const_iterator rr=rp;
-		while ((lp!=lrm)&&isdigit(*lp)) ++lp;
-		while ((rp!=rrm)&&isdigit(*rp)) ++rp;
-		if (int cmp=cmp_num(lr,lp,rr,rp)) return cmp;
+		const segment& lseg=(lfirst!=llast)?*lfirst++:empty;
+		const segment& rseg=(rfirst!=rlast)?*rfirst++:empty;
+		if (int cmp=cmp_lex(lstr+lseg.lex_first,lstr+lseg.lex_last,
+			rstr+rseg.lex_first,rstr+rseg.lex_last)) return cmp;
+		if (int cmp=compare_num(lstr,lseg,rstr,rseg)) return cmp;
 	}
 	return 0;
 }
 
-/** Compare two versions.
- * @param lhs the left hand side
- * @param rhs the right hand side
- * @return 0 if lhs==rhs, +1 if lhs>rhs or -1 if lhs<rhs
- */
-static int cmp_version(const version& lhs,const version& rhs)
+version::version():
+	_epoch_length(0),
+	_upstream_length(0)
 {
-	if (int cmp=cmp_epoch(lhs.epoch(),rhs.epoch()))
-		return cmp;
-	if (int cmp=cmp_verstr(lhs.upstream_version(),rhs.upstream_version()))
-		return cmp;
-	if (int cmp=cmp_verstr(lhs.package_version(),rhs.package_version()))
-		return cmp;
-	return 0;
+	tokenize();
 }
 
-version::version()
-{}
-
 version::version(const string& epoch,const string& upstream_version,
-	const string& package_version):
-	_epoch(epoch),
-	_upstream_version(upstream_version),
-	_package_version(package_version)
+	const string& package_version)
 {
+	assign(epoch.data(),epoch.length(),
+		upstream_version.data(),upstream_version.length(),
+		package_version.data(),package_version.length());
 	validate();
+	tokenize();
 }
 
 version::version(string::const_iterator first,
@@ -207,122 +143,291 @@ version::version(string::const_iterator first,
 {
 	parse(first,last);
 	validate();
+	tokenize();
 }
 
 version::version(const string& verstr)
 {
 	parse(verstr.begin(),verstr.end());
 	validate();
+	tokenize();
 }
 
 version::operator string() const
 {
 	// Determine whether the upstream version needed to be introduced
 	// by a colon and/or terminated by a minus sign.
-	bool include_colon=(_epoch.length()!=0)||
-		(_upstream_version.find(':')!=string::npos);
-	bool include_minus=(_package_version.length()!=0)||
-		(_upstream_version.find('-')!=string::npos);
+	const char* upstream=upstream_data();
+	bool include_colon=(_epoch_length!=0)||
+		memchr(upstream,':',_upstream_length);
+	bool include_minus=(package_length()!=0)||
+		memchr(upstream,'-',_upstream_length);
 
 	// Calculate length of result.
-	unsigned int length=_epoch.length()+include_colon+
-		_upstream_version.length()+include_minus+_package_version.length();
+	unsigned int length=_epoch_length+include_colon+
+		_upstream_length+include_minus+package_length();
 
 	// Construct result.
 	string verstr;
 	verstr.reserve(length);
 	if (include_colon)
 	{
-		verstr.append(_epoch);
+		verstr.append(epoch_data(),_epoch_length);
 		verstr.push_back(':');
 	}
-	verstr.append(_upstream_version);
+	verstr.append(upstream,_upstream_length);
 	if (include_minus)
 	{
 		verstr.push_back('-');
-		verstr.append(_package_version);
+		verstr.append(package_data(),package_length());
 	}
 	return verstr;
 }
 
+void version::assign(const char* epoch,unsigned int epoch_length,
+	const char* upstream,unsigned int upstream_length,
+	const char* package,unsigned int package_length)
+{
+	unsigned int length=epoch_length+upstream_length+package_length;
+	if (length>max_length) throw parse_error("version too long");
+	_text.resize(length);
+	char* p=_text.data();
+	memcpy(p,epoch,epoch_length);
+	memcpy(p+epoch_length,upstream,upstream_length);
+	memcpy(p+epoch_length+upstream_length,package,package_length);
+	_epoch_length=epoch_length;
+	_upstream_length=upstream_length;
+}
+
 void version::parse(string::const_iterator first,string::const_iterator last)
 {
-	// Extract epoch.
-	string::const_iterator cs=first;
-	while ((cs!=last)&&(*cs!=':')) ++cs;
-	if (cs!=last)
+	const char* p=(first!=last)?&*first:"";
+	unsigned int length=last-first;
+
+	// Find epoch.
+	unsigned int epoch_length=0;
+	unsigned int upstream_first=0;
+	unsigned int cs=0;
+	while ((cs!=length)&&(p[cs]!=':')) ++cs;
+	if (cs!=length)
 	{
-		_epoch=string(first,cs);
-		first=cs+1;
+		epoch_length=cs;
+		upstream_first=cs+1;
 	}
 
-	// Extract package version.
-	string::const_iterator ds=last;
-	while ((ds!=first)&&(*(ds-1)!='-')) --ds;
-	if (ds!=first)
+	// Find package version.
+	unsigned int upstream_last=length;
+	unsigned int package_first=length;
+	unsigned int ds=length;
+	while ((ds!=upstream_first)&&(p[ds-1]!='-')) --ds;
+	if (ds!=upstream_first)
 	{
-		_package_version=string(ds,last);
-		last=ds-1;
+		package_first=ds;
+		upstream_last=ds-1;
 	}
 
-	// Extract upstream version.
-	_upstream_version=string(first,last);
+	// Extract epoch, upstream version and package version.
+	assign(p,epoch_length,p+upstream_first,upstream_last-upstream_first,
+		p+package_first,length-package_first);
 }
 
 void version::validate() const
 {
-	for (string::const_iterator i=_epoch.begin();i!=_epoch.end();++i)
+	const char* epoch=epoch_data();
+	for (unsigned int i=0;i!=_epoch_length;++i)
 	{
-		char ch=*i;
+		char ch=epoch[i];
 		if (!isdigit(ch))
 			throw parse_error("illegal character in epoch");
 	}
 
-	for (string::const_iterator i=_upstream_version.begin();
-		i!=_upstream_version.end();++i)
+	const char* upstream=upstream_data();
+	for (unsigned int i=0;i!=_upstream_length;++i)
 	{
-		char ch=*i;
+		char ch=upstream[i];
 		if (!isalnum(ch)&&(ch!='+')&&(ch!='-')&&(ch!='.')&&(ch!='~')&&(ch!=':'))
 			throw parse_error("illegal character in upstream version");
 	}
 
-	for (string::const_iterator i=_package_version.begin();
-		i!=_package_version.end();++i)
+	const char* package=package_data();
+	for (unsigned int i=0,length=package_length();i!=length;++i)
 	{
-		char ch=*i;
+		char ch=package[i];
 		if (!isalnum(ch)&&(ch!='+')&&(ch!='.')&&(ch!='~'))
 			throw parse_error("illegal character in package version");
 	}
 }
 
+void version::tokenize()
+{
+	_segment_count=0;
+	_extra_segments.clear();
+
+	// The epoch consists of a single numeric part.
+	const char* epoch=epoch_data();
+	segment seg={0,0,0,_epoch_length};
+	while ((seg.num_first!=seg.num_last)&&(epoch[seg.num_first]=='0'))
+		++seg.num_first;
+	push_segment(seg);
+
+	tokenize(upstream_data(),_upstream_length);
+	_package_segment=_segment_count;
+	tokenize(package_data(),package_length());
+}
+
+void version::tokenize(const char* p,unsigned int length)
+{
+	unsigned int i=0;
+	while (i!=length)
+	{
+		segment seg;
+
+		// Find non-numeric part.
+		seg.lex_first=i;
+		while ((i!=length)&&!isdigit(p[i])) ++i;
+		seg.lex_last=i;
+
+		// Find numeric part, skipping leading zeros.
+		while ((i!=length)&&(p[i]=='0')) ++i;
+		seg.num_first=i;
+		while ((i!=length)&&isdigit(p[i])) ++i;
+		seg.num_last=i;
+		push_segment(seg);
+	}
+}
+
+void version::push_segment(const segment& seg)
+{
+	// Segments are moved out of the object when it becomes full.
+	if (_segment_count<inline_segments)
+	{
+		_inline_segments[_segment_count++]=seg;
+		return;
+	}
+	if (_segment_count==inline_segments)
+	{
+		_extra_segments.assign(_inline_segments,
+			_inline_segments+inline_segments);
+	}
+	_extra_segments.push_back(seg);
+	++_segment_count;
+}
+
+int version::compare(const version& rhs) const
+{
+	const segment* lseg=segments();
+	const segment* rseg=rhs.segments();
+	if (int cmp=compare_num(epoch_data(),lseg[0],
+		rhs.epoch_data(),rseg[0]))
+		return cmp;
+	if (int cmp=compare_segments(
+		upstream_data(),lseg+1,lseg+_package_segment,
+		rhs.upstream_data(),rseg+1,rseg+rhs._package_segment))
+		return cmp;
+	return compare_segments(
+		package_data(),lseg+_package_segment,lseg+_segment_count,
+		rhs.package_data(),rseg+rhs._package_segment,
+		rseg+rhs._segment_count);
+}
+
+string version::sort_key() const
+{
+	string key;
+	key.reserve(_text.length()+_segment_count*2+8);
+	const segment* segs=segments();
+	append_num_key(epoch_data(),segs[0],key);
+	append_segments_key(upstream_data(),
+		segs+1,segs+_package_segment,key);
+	append_segments_key(package_data(),
+		segs+_package_segment,segs+_segment_count,key);
+	return key;
+}
+
+void version::append_num_key(const char* str,const segment& seg,
+	string& key)
+{
+	// A zero (or missing) numeric part is encoded as a single byte,
+	// because it must compare equal to the padding that follows the
+	// last segment.
+	unsigned int length=seg.num_last-seg.num_first;
+	if (!length)
+	{
+		key.push_back(0x02);
+		return;
+	}
+
+	// Otherwise the length is encoded before the digits, so that
+	// longer numbers sort later.  Lengths that do not fit in one byte
+	// are preceded by 0xff and encoded in four bytes, big-endian.
+	key.push_back(0x03);
+	if (length<0xff)
+	{
+		key.push_back(static_cast<char>(length));
+	}
+	else
+	{
+		key.push_back(static_cast<char>(0xff));
+		for (int shift=24;shift>=0;shift-=8)
+			key.push_back(static_cast<char>((length>>shift)&0xff));
+	}
+	key.append(str+seg.num_first,length);
+}
+
+void version::append_segments_key(const char* str,const segment* first,
+	const segment* last,string& key)
+{
+	// Trailing segments that are equivalent to an empty segment
+	// are omitted, so that equal versions have identical keys.
+	while ((last!=first)&&((last-1)->lex_first==(last-1)->lex_last)&&
+		((last-1)->num_first==(last-1)->num_last)) --last;
+
+	for (;first!=last;++first)
+	{
+		for (unsigned int i=first->lex_first;i!=first->lex_last;++i)
+		{
+			unsigned char ch=str[i];
+			if (ch=='~') key.push_back(0x01);
+			else if (isalpha(ch)) key.push_back(ch);
+			else key.push_back(static_cast<char>(0x80+ch));
+		}
+		append_num_key(str,*first,key);
+	}
+
+	// Only the first segment can consist of 0x02 alone, and every other
+	// segment begins with a byte other than 0x02, so a pair of them
+	// compares with what follows as an unlimited number of empty
+	// segments would.
+	key.append(2,0x02);
+}
+
 bool operator==(const version& lhs,const version& rhs)
 {
-	return cmp_version(lhs,rhs)==0;
+	return lhs.compare(rhs)==0;
 }
 
 bool operator!=(const version& lhs,const version& rhs)
 {
-	return cmp_version(lhs,rhs)!=0;
+	return lhs.compare(rhs)!=0;
 }
 
 bool operator<(const version& lhs,const version& rhs)
 {
-	return cmp_version(lhs,rhs)<0;
+	return lhs.compare(rhs)<0;
 }
 
 bool operator>=(const version& lhs,const version& rhs)
 {
-	return cmp_version(lhs,rhs)>=0;
+	return lhs.compare(rhs)>=0;
 }
 
 bool operator<=(const version& lhs,const version& rhs)
 {
-	return cmp_version(lhs,rhs)<=0;
+	return lhs.compare(rhs)<=0;
 }
 
 bool operator>(const version& lhs,const version& rhs)
 {
-	return cmp_version(lhs,rhs)>0;
+	return lhs.compare(rhs)>0;
 }
 
 version::parse_error::parse_error(const char* message):
@@ -20,6 +20,9 @@
 #include <exception>
 #include <stdexcept>
 #include <string>
+#include <vector>
+
+#include "libpkg/short_string.h"
 
 namespace pkg {
 
@@ -34,14 +37,64 @@ class version
 public:
 	class parse_error;
 private:
-	/** The epoch. */
-	string _epoch;
+	/** A class to represent one segment of a version string.
+	 * A segment consists of a non-numeric part followed by a numeric
+	 * part, either or both of which may be empty.  Positions are
+	 * offsets into the epoch, upstream version or package version.
+	 */
+	struct segment
+	{
+		/** The beginning of the non-numeric part. */
+		unsigned short lex_first;
+
+		/** The end of the non-numeric part. */
+		unsigned short lex_last;
+
+		/** The beginning of the numeric part, excluding leading zeros. */
+		unsigned short num_first;
+
+		/** The end of the numeric part. */
+		unsigned short num_last;
+	};
+
+	/** The maximum total length of the epoch, upstream version and
+	 * package version. */
+	static const unsigned int max_length=0xffff;
+
+	/** The number of characters that can be held without allocating
+	 * memory. */
+	static const unsigned int inline_length=24;
+
+	/** The number of segments that can be held without allocating
+	 * memory. */
+	static const unsigned int inline_segments=8;
+
+	/** The epoch, upstream version and package version, concatenated
+	 * without separators. */
+	short_string<inline_length> _text;
+
+	/** The length of the epoch. */
+	unsigned short _epoch_length;
+
+	/** The length of the upstream version. */
+	unsigned short _upstream_length;
 
-	/** The upstream version. */
-	string _upstream_version;
+	/** The number of segments. */
+	unsigned short _segment_count;
 
-	/** The package version. */
-	string _package_version;
+	/** The index of the first segment of the package version. */
+	unsigned short _package_segment;
+
+	/** The segments of the version, if there are no more than
+	 * inline_segments of them.
+	 * The first segment is the epoch.  It is followed by the segments
+	 * of the upstream version, then those of the package version.
+	 */
+	segment _inline_segments[inline_segments];
+
+	/** The segments of the version, if there are more than
+	 * inline_segments of them. */
+	std::vector<segment> _extra_segments;
 public:
 	/** Construct version with default value.
 	 * By default the epoch, upstream version and package version are
@@ -88,20 +141,91 @@ public:
 	 * @return the epoch
 	 */
 	string epoch() const
-		{ return _epoch; }
+		{ return string(epoch_data(),_epoch_length); }
 
 	/** Get upstream version.
 	 * @return the upstream version
 	 */
 	string upstream_version() const
-		{ return _upstream_version; }
+		{ return string(upstream_data(),_upstream_length); }
 
 	/** Get package version.
 	 * @return the package version
 	 */
 	string package_version() const
-		{ return _package_version; }
+		{ return string(package_data(),package_length()); }
+
+	/** Compare with another version.
+	 * The version strings are split into segments when the versions
+	 * are constructed, so they do not need to be parsed again here.
+	 * @param rhs the version to compare with
+	 * @return 0 if *this==rhs, +1 if *this>rhs or -1 if *this<rhs
+	 */
+	int compare(const version& rhs) const;
+
+	/** Get sort key.
+	 * The sort key is a byte string which, when compared using memcmp
+	 * (with the shorter key sorting first if one is a prefix of the
+	 * other), gives the same ordering as the comparison operators.
+	 * Versions which compare as equal have identical sort keys.
+	 *
+	 * Within each non-numeric part a tilde is encoded as 0x01, a letter
+	 * as itself and any other character as 0x80 plus its code.  The end
+	 * of a non-numeric part is encoded as 0x02 if the numeric part that
+	 * follows it is zero, or as 0x03 followed by the number of
+	 * significant digits and the digits themselves if not.  The upstream
+	 * version and package version are each terminated by two 0x02 bytes,
+	 * which sort as if the version had been padded with empty segments.
+	 * @return the sort key
+	 */
+	string sort_key() const;
 private:
+	/** Get the characters of the epoch.
+	 * @return a pointer to the first character
+	 */
+	const char* epoch_data() const
+		{ return _text.data(); }
+
+	/** Get the characters of the upstream version.
+	 * @return a pointer to the first character
+	 */
+	const char* upstream_data() const
+		{ return _text.data()+_epoch_length; }
+
+	/** Get the characters of the package version.
+	 * @return a pointer to the first character
+	 */
+	const char* package_data() const
+		{ return _text.data()+_epoch_length+_upstream_length; }
+
+	/** Get the length of the package version.
+	 * @return the number of characters
+	 */
+	unsigned int package_length() const
+		{ return _text.length()-_epoch_length-_upstream_length; }
+
+	/** Get the segments.
+	 * @return a pointer to the first segment
+	 */
+	const segment* segments() const
+	{
+		return (_segment_count>inline_segments)?
+			&_extra_segments[0]:_inline_segments;
+	}
+
+	/** Set epoch, upstream version and package version.
+	 * If the combined length is too great then a parse error is thrown.
+	 * @param epoch the epoch
+	 * @param epoch_length the length of the epoch
+	 * @param upstream the upstream version
+	 * @param upstream_length the length of the upstream version
+	 * @param package the package version
+	 * @param package_length the length of the package version
+	 */
+	void assign(const char* epoch,unsigned int epoch_length,
+		const char* upstream,unsigned int upstream_length,
+		const char* package,unsigned int package_length);
+
 	/** Parse version.
 	 * @param first the beginning of the sequence
 	 * @param last the end of the sequence
@@ -113,6 +237,66 @@ private:
 	 * parse_error is thrown.
 	 */
 	void validate() const;
+
+	/** Split the epoch, upstream version and package version into
+	 * segments. */
+	void tokenize();
+
+	/** Split an upstream version or package version into segments.
+	 * @param p the upstream version or package version
+	 * @param length the length of the upstream version or package version
+	 */
+	void tokenize(const char* p,unsigned int length);
+
+	/** Append a segment.
+	 * @param seg the segment to be appended
+	 */
+	void push_segment(const segment& seg);
+
+	/** Compare the numeric parts of two segments.
+	 * Leading zeros have already been skipped, so numbers of different
+	 * lengths compare by length and numbers of equal length compare
+	 * digit by digit.
+	 * @param lstr the string containing the left hand side
+	 * @param lseg the left hand side
+	 * @param rstr the string containing the right hand side
+	 * @param rseg the right hand side
+	 * @return 0 if lhs==rhs, +1 if lhs>rhs or -1 if lhs<rhs
+	 */
+	static int compare_num(const char* lstr,const segment& lseg,
+		const char* rstr,const segment& rseg);
+
+	/** Compare two upstream versions or package versions.
+	 * If one side has fewer segments than the other then it is treated
+	 * as if it had been padded with empty segments.
+	 * @param lstr the string containing the left hand side
+	 * @param lfirst the first segment of the left hand side
+	 * @param llast the end of the segments of the left hand side
+	 * @param rstr the string containing the right hand side
+	 * @param rfirst the first segment of the right hand side
+	 * @param rlast the end of the segments of the right hand side
+	 * @return 0 if lhs==rhs, +1 if lhs>rhs or -1 if lhs<rhs
+	 */
+	static int compare_segments(const char* lstr,const segment* lfirst,
+		const segment* llast,const char* rstr,const segment* rfirst,
+		const segment* rlast);
+
+	/** Append the numeric part of a segment to a sort key.
+	 * @param str the string containing the segment
+	 * @param seg the segment
+	 * @param key the sort key
+	 */
+	static void append_num_key(const char* str,const segment& seg,
+		string& key);
+
+	/** Append an upstream version or package version to a sort key.
+	 * @param str the string containing the segments
+	 * @param first the first segment
+	 * @param last the end of the segments
+	 * @param key the sort key
+	 */
+	static void append_segments_key(const char* str,const segment* first,
+		const segment* last,string& key);
 };
 
 /** Test whether two versions are equal.
@@ -0,0 +1,177 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark counting the number of write operations needed to commit
+// a package index through commit_writer, with a flush after every line
+// (as when std::endl was used) and with lines ended by '\n'.  Each
+// commit replaces an existing file, and the result is checked.
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "libpkg/binary_control.h"
+#include "libpkg/commit_writer.h"
+#include "libpkg/filesystem.h"
+
+#include "test_util.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+
+using pkg::binary_control;
+using pkg::commit_writer;
+
+/** The number of records in the synthetic index. */
+const unsigned int record_count=20000;
+
+/** Generate a synthetic package index.
+ * @param count the number of records to generate
+ * @return the control records
+ */
+std::vector<binary_control> make_index(unsigned int count)
+{
+	std::vector<binary_control> result;
+	for (unsigned int i=0;i!=count;++i)
+	{
+		std::ostringstream pkgname;
+		pkgname << "Package" << i;
+		std::ostringstream version;
+		version << (i%7) << "." << (i%13) << "-" << (i%3+1);
+		binary_control ctrl;
+		ctrl["Package"]=pkgname.str();
+		ctrl["Version"]=version.str();
+		ctrl["Priority"]="optional";
+		ctrl["Section"]="Library";
+		ctrl["Maintainer"]="Some One <some.one@example.org>";
+		ctrl["Standards-Version"]="0.6.0";
+		ctrl["Size"]="12345";
+		ctrl["URL"]="http://www.example.org/pkg/"+pkgname.str()+".zip";
+		ctrl["Description"]="Synthetic package\nA longer description\n\n"
+			"with an empty line.";
+		result.push_back(ctrl);
+	}
+	return result;
+}
+
+/** Write records with a flush after every line.
+ * @param index the control records
+ * @param out the output stream
+ */
+void write_flushed(const std::vector<binary_control>& index,
+	std::ostream& out)
+{
+	for (unsigned int i=0;i!=index.size();++i)
+	{
+		std::ostringstream record;
+		record << index[i] << '\n';
+		std::istringstream in(record.str());
+		string line;
+		while (getline(in,line)) out << line << std::endl;
+	}
+}
+
+/** Write records without flushing.
+ * @param index the control records
+ * @param out the output stream
+ */
+void write_buffered(const std::vector<binary_control>& index,
+	std::ostream& out)
+{
+	for (unsigned int i=0;i!=index.size();++i)
+		out << index[i] << '\n';
+}
+
+/** Check that a file has the expected content, and that no temporary
+ * or backup file remains.
+ * @param pathname the pathname of the file
+ * @param expected the expected content
+ * @param name the name of the check
+ * @param errors the error count
+ */
+void check_file(const string& pathname,const string& expected,
+	const string& name,unsigned int* errors)
+{
+	string content;
+	pkg::read_file(pathname,content);
+	test::check(content==expected,(name+": file content").c_str(),errors);
+	test::check(pkg::object_type(pathname+string("++"))==0,
+		(name+": temporary file removed").c_str(),errors);
+	test::check(pkg::object_type(pathname+string("--"))==0,
+		(name+": backup file removed").c_str(),errors);
+}
+
+/** Compare the number of writes with and without flushing.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	std::vector<binary_control> index=make_index(record_count);
+	std::ostringstream expected;
+	write_buffered(index,expected);
+	string pathname=test::write_fixture("Available","old content\n");
+
+	// Flush after every line, with a buffer of the size that the
+	// standard library would use.
+	unsigned int flushed_writes=0;
+	{
+		commit_writer writer(pathname,BUFSIZ);
+		write_flushed(index,writer.out());
+		flushed_writes=writer.writes();
+		test::check(writer.commit(),"flushed commit",errors);
+	}
+	check_file(pathname,expected.str(),"flushed",errors);
+	cout << "Flush per line: " << flushed_writes << " writes" << endl;
+
+	// End lines with '\n' and use the default buffer.  Nothing is
+	// visible in place of the existing file until the commit.
+	test::write_fixture("Available","old content\n");
+	unsigned int buffered_writes=0;
+	{
+		commit_writer writer(pathname);
+		write_buffered(index,writer.out());
+		string content;
+		pkg::read_file(pathname,content);
+		test::check(content==string("old content\n"),"before commit",
+			errors);
+		test::check(writer.commit(),"buffered commit",errors);
+		buffered_writes=writer.writes();
+	}
+	check_file(pathname,expected.str(),"buffered",errors);
+	cout << "commit_writer:  " << buffered_writes << " writes, " <<
+		expected.str().size() << " bytes" << endl;
+
+	test::check(buffered_writes<=flushed_writes/100,
+		"too many writes",errors);
+
+	// A writer destroyed without being committed leaves the file as it
+	// was.
+	{
+		commit_writer writer(pathname);
+		writer.out() << "abandoned\n";
+	}
+	string content;
+	pkg::read_file(pathname,content);
+	test::check(content==expected.str(),"abandoned writer",errors);
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
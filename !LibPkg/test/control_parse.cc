@@ -0,0 +1,497 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark comparing the original line-by-line control file parser,
+// control::operator>> and the in-memory tokenizer (control_cursor and
+// parse_control) on a synthetic package index, and the line search used
+// by the tokenizer with and without vector instructions.  Also tests the
+// checks made on records read using control_cursor and the writing of
+// fields which have not been decoded.
+
+#include <cctype>
+#include <ctime>
+#include <memory>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "libpkg/binary_control.h"
+#include "libpkg/control_cursor.h"
+
+#include "test_util.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+
+using pkg::binary_control;
+using pkg::control;
+using pkg::control_cursor;
+using pkg::field_name_set;
+
+/** The number of records in the synthetic index. */
+const unsigned int record_count=20000;
+
+/** Generate a synthetic package index.
+ * @param count the number of records to generate
+ * @return the index
+ */
+string make_index(unsigned int count)
+{
+	std::ostringstream out;
+	for (unsigned int i=0;i!=count;++i)
+	{
+		if (i) out << "\n";
+		out << "Package: Package" << i << "\n";
+		out << "Priority: optional\n";
+		out << "Section: Library\n";
+		out << "Maintainer: Some One <some.one@example.org>\n";
+		out << "Standards-Version: 0.6.0\n";
+		out << "Version: " << (i%7) << "." << (i%13) << "-" << (i%3+1) << "\n";
+		if (i%4==0) out << "Environment: arm\n";
+		out << "Depends: Package" << (i*7)%count << ", Package"
+			<< (i*13)%count << " (>= 1.0)\n";
+		out << "Size: " << 1000+i*17 << "\n";
+		out << "MD5Sum: 0123456789abcdef0123456789abcdef\n";
+		out << "URL: http://www.example.org/pkg/Package" << i << ".zip\n";
+		out << "Description: Synthetic package number " << i << "\n";
+		out << " A longer description that spans more than one line,\n";
+		out << " .\n";
+		out << " including an empty paragraph separator.  \n";
+	}
+	return out.str();
+}
+
+/** Read a control record as the original operator>> did.
+ * Each line is read separately, and scanned a character at a time using
+ * isspace().  This is kept for comparison with the current parsers.
+ * @param in the input stream
+ * @param ctrl the control record
+ */
+void read_lines(std::istream& in,control& ctrl)
+{
+	string fieldname;
+	string value;
+	bool field=false;
+	bool done=false;
+	while (in&&!done)
+	{
+		// Get line from input stream.
+		string line;
+		getline(in,line);
+
+		// Convert to sequence.
+		string::const_iterator first=line.begin();
+		string::const_iterator last=line.end();
+
+		// Strip trailing spaces.
+		while ((last!=first)&&isspace(*(last-1))) --last;
+
+		if ((first==last)||isspace(*first))
+		{
+			// Line is blank or begins with a space:
+			// Skip leading spaces.
+			string::const_iterator p=first;
+			while ((p!=last)&&isspace(*p)) ++p;
+			if (p==last)
+			{
+				// Line is blank (or contains only spaces):
+				done=true;
+			}
+			else
+			{
+				// Line is a continuation line:
+				// Check whether there is a field to continue.
+				if (!field)
+					throw control::parse_error(
+						"continuation line not allowed here");
+
+				// If line contains nothing but a period
+				// then skip that character.
+				if ((p+1==last)&&(*p=='.')) ++p;
+
+				// Append continuation line to field.
+				value+=string("\n");
+				value+=string(p,last);
+			}
+		}
+		else
+		{
+			// Line does not begin with a space:
+			// Parse fieldname.
+			string::const_iterator p=first;
+			while ((p!=last)&&(*p!=':'))
+			{
+				if (isspace(*p))
+					throw control::parse_error("syntax error");
+				++p;
+			}
+			if (field) ctrl[fieldname]=value;
+			fieldname=string(first,p);
+			if (ctrl.find(fieldname)!=ctrl.end())
+				throw control::parse_error("duplicate field name");
+
+			// Parse colon at end of fieldname.
+			if ((p!=last)&&(*p==':')) ++p;
+			else throw control::parse_error("':' expected");
+
+			// Skip spaces.
+			while ((p!=last)&&isspace(*p)) ++p;
+
+			// Hold field value until any continuation lines are read.
+			value=string(p,last);
+			field=true;
+		}
+	}
+	if (field) ctrl[fieldname]=value;
+}
+
+/** Parse an index using the original line-by-line parser.
+ * @param index the index
+ * @param result a vector to which the records are appended
+ */
+void parse_lines(const string& index,std::vector<binary_control>& result)
+{
+	std::istringstream in(index);
+	while (in&&!in.eof())
+	{
+		binary_control ctrl;
+		read_lines(in,ctrl);
+		result.push_back(ctrl);
+		while (in.peek()=='\n') in.get();
+	}
+}
+
+/** Parse an index using operator>>.
+ * @param index the index
+ * @param result a vector to which the records are appended
+ */
+void parse_stream(const string& index,std::vector<binary_control>& result)
+{
+	std::istringstream in(index);
+	while (in&&!in.eof())
+	{
+		binary_control ctrl;
+		in >> ctrl;
+		result.push_back(ctrl);
+		while (in.peek()=='\n') in.get();
+	}
+}
+
+/** Parse an index using parse_control.
+ * @param index the index
+ * @param result a vector to which the records are appended
+ */
+void parse_buffer(const string& index,std::vector<binary_control>& result)
+{
+	string::const_iterator p=index.begin();
+	while (p!=index.end())
+	{
+		binary_control ctrl;
+		p=pkg::parse_control(p,index.end(),ctrl);
+		result.push_back(ctrl);
+	}
+}
+
+/** Tokenize an index using control_cursor without decoding any values.
+ * @param index the index
+ * @return the number of fields found
+ */
+unsigned int tokenize(const string& index)
+{
+	unsigned int count=0;
+	control_cursor cursor(index.begin(),index.end());
+	while (cursor.next_record())
+	{
+		while (cursor.next_field()) ++count;
+	}
+	return count;
+}
+
+/** The type of a function for finding a character. */
+typedef const char* (*find_function)(const char*,const char*,char);
+
+/** Find every newline in an index.
+ * @param index the index
+ * @param find the function used to find each newline
+ * @return the sum of the offsets of the newlines
+ */
+unsigned long find_newlines(const string& index,find_function find)
+{
+	unsigned long sum=0;
+	const char* first=index.data();
+	const char* last=first+index.size();
+	for (const char* p=find(first,last,'\n');p!=last;
+		p=find(p+1,last,'\n'))
+	{
+		sum+=p-first;
+	}
+	return sum;
+}
+
+/** Compare two sequences of records.
+ * @param a the first sequence
+ * @param b the second sequence
+ * @param errors the error count
+ */
+void compare(const std::vector<binary_control>& a,
+	const std::vector<binary_control>& b,unsigned int* errors)
+{
+	if (!test::check(a.size(),b.size(),"record count",errors)) return;
+	for (unsigned int i=0;i!=a.size();++i)
+	{
+		binary_control::const_iterator j=a[i].begin();
+		binary_control::const_iterator k=b[i].begin();
+		while ((j!=a[i].end())&&(k!=b[i].end())&&
+			(string(j->first)==string(k->first))&&(j->second==k->second))
+		{
+			++j;
+			++k;
+		}
+		if ((j!=a[i].end())||(k!=b[i].end()))
+		{
+			cout << "Record " << i << " differs" << endl;
+			++*errors;
+		}
+	}
+}
+
+/** Test whether a record contains duplicate fields.
+ * The record is read using a control_cursor and field_name_set, as it
+ * is when source lists are merged.
+ * @param record the record
+ * @return true if there is a duplicate field, otherwise false
+ */
+bool has_duplicate(const string& record)
+{
+	control_cursor cursor(record.begin(),record.end());
+	field_name_set names;
+	while (cursor.next_record())
+	{
+		names.clear();
+		while (cursor.next_field())
+		{
+			if (!names.insert(cursor)) return true;
+		}
+	}
+	return false;
+}
+
+/** Test whether a record is rejected as malformed.
+ * @param record the record
+ * @return true if a parse error was thrown, otherwise false
+ */
+bool is_malformed(const string& record)
+{
+	try
+	{
+		has_duplicate(record);
+	}
+	catch (control::parse_error&)
+	{
+		return true;
+	}
+	return false;
+}
+
+/** Test whether a record is rejected by parse_control.
+ * @param record the record
+ * @param shared true to parse from a shared buffer, with decoding of
+ *  some fields deferred, or false to parse from a pair of iterators
+ * @return true if a parse error was thrown, otherwise false
+ */
+bool is_rejected(const string& record,bool shared)
+{
+	try
+	{
+		binary_control ctrl;
+		if (shared)
+		{
+			std::shared_ptr<const string> source(new string(record));
+			pkg::parse_control(source,0,source->size(),ctrl);
+		}
+		else pkg::parse_control(record.begin(),record.end(),ctrl);
+	}
+	catch (control::parse_error&)
+	{
+		return true;
+	}
+	return false;
+}
+
+/** Check that both forms of parse_control find the same duplicates.
+ * @param errors the error count
+ */
+void check_duplicates(unsigned int* errors)
+{
+	for (unsigned int shared=0;shared!=2;++shared)
+	{
+		test::check(!is_rejected("Package: a\nFoo: x\nfoo: y\n",shared),
+			"non-standard fields differing in case",errors);
+		test::check(is_rejected("Package: a\nFoo: x\nFoo: y\n",shared),
+			"duplicate non-standard field",errors);
+		test::check(is_rejected(
+			"Package: a\nDescription: x\ndescription: y\n",shared),
+			"duplicate description",errors);
+		test::check(is_rejected("Package: a\nVersion: 1\nversion: 2\n",
+			shared),"duplicate standard field",errors);
+	}
+}
+
+/** Check that deferred fields are written without being decoded.
+ * @param errors the error count
+ */
+void check_write_deferred(unsigned int* errors)
+{
+	string deferred="Description: Short\n Long\n .\n More\nX-Odd: y\n";
+	std::shared_ptr<const string> source(new string(
+		"Package: a\nVersion: 1\n"+deferred+"\n"));
+	binary_control ctrl;
+	pkg::parse_control(source,0,source->size(),ctrl);
+
+	// Undecoded fields are copied from the buffer as they were.
+	std::ostringstream out;
+	ctrl.write_deferred(out);
+	test::check(out.str(),deferred,"undecoded fields written",errors);
+
+	// Decoded fields are written in control file format, and read back
+	// with the same values.
+	string description=ctrl.description();
+	out.str(string());
+	ctrl.write_deferred(out);
+	string text=out.str();
+	binary_control copy;
+	pkg::parse_control(text.begin(),text.end(),copy);
+	test::check(copy.description(),description,
+		"decoded description written",errors);
+	test::check(copy["X-Odd"].str(),string("y"),
+		"decoded non-standard field written",errors);
+	test::check(copy.find(control::field_package)==copy.end(),
+		"other fields not written",errors);
+}
+
+/** Check that a control file is written without decoding its fields.
+ * @param errors the error count
+ */
+void check_write(unsigned int* errors)
+{
+	std::shared_ptr<const string> source(new string(
+		"Package: a\nX-Odd:y\nVersion: 1\nDescription: Short\n Long\n"
+		"Licence: Free\nAaa: z\n\n"));
+	binary_control ctrl;
+	pkg::parse_control(source,0,source->size(),ctrl);
+
+	// Fields are written in the same order as when decoded, but
+	// undecoded fields keep the text they had in the buffer.
+	std::ostringstream out;
+	out << ctrl;
+	test::check(out.str(),string("Package: a\nVersion: 1\nAaa: z\n"
+		"Licence: Free\nX-Odd:y\nDescription: Short\n Long\n"),
+		"undecoded fields written in order",errors);
+
+	binary_control decoded(ctrl);
+	decoded.description();
+	std::ostringstream decoded_out;
+	decoded_out << decoded;
+	test::check(decoded_out.str(),string("Package: a\nVersion: 1\n"
+		"Aaa: z\nLicence: Free\nX-Odd: y\nDescription: Short\n Long\n"),
+		"decoded fields written in order",errors);
+}
+
+/** Check that records are validated without building control objects.
+ * @param errors the error count
+ */
+void check_validation(unsigned int* errors)
+{
+	test::check(!has_duplicate("Package: a\nVersion: 1\nFoo: x\n"),
+		"no duplicate",errors);
+	test::check(has_duplicate("Package: a\nVersion: 1\nversion: 2\n"),
+		"duplicate standard field",errors);
+	test::check(has_duplicate("Package: a\nFoo: x\nFoo: y\n"),
+		"duplicate non-standard field",errors);
+	test::check(!has_duplicate("Package: a\nFoo: x\nfoo: y\n"),
+		"non-standard fields differing in case",errors);
+	test::check(!has_duplicate("Package: a\nFoo: x\n\nPackage: b\nFoo: y\n"),
+		"same field in different records",errors);
+	test::check(is_malformed("Package: a\nVersion 1\n"),
+		"missing colon",errors);
+	test::check(is_malformed("Package: a\nBad name: 1\n"),
+		"space in field name",errors);
+}
+
+/** Compare the parsers on a synthetic index.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	string index=make_index(record_count);
+	cout << "Index: " << record_count << " records, " <<
+		index.size() << " bytes" << endl;
+
+	std::vector<binary_control> by_lines;
+	clock_t start=clock();
+	parse_lines(index,by_lines);
+	double lines_time=test::elapsed(start);
+	cout << "original:      " << lines_time << "s" << endl;
+
+	std::vector<binary_control> by_stream;
+	start=clock();
+	parse_stream(index,by_stream);
+	double stream_time=test::elapsed(start);
+	cout << "operator>>:    " << stream_time << "s" << endl;
+
+	std::vector<binary_control> by_buffer;
+	start=clock();
+	parse_buffer(index,by_buffer);
+	double buffer_time=test::elapsed(start);
+	cout << "parse_control: " << buffer_time << "s" << endl;
+
+	start=clock();
+	unsigned int fields=tokenize(index);
+	double tokenize_time=test::elapsed(start);
+	cout << "tokenize only: " << tokenize_time << "s (" <<
+		fields << " fields)" << endl;
+
+	// Time the line search on its own, repeated so that the times are
+	// large enough to measure.
+	const unsigned int repeats=20;
+	unsigned long scalar_sum=0;
+	start=clock();
+	for (unsigned int i=0;i!=repeats;++i)
+		scalar_sum=find_newlines(index,pkg::find_char_scalar);
+	double scalar_time=test::elapsed(start);
+	unsigned long vector_sum=0;
+	start=clock();
+	for (unsigned int i=0;i!=repeats;++i)
+		vector_sum=find_newlines(index,pkg::find_char);
+	double vector_time=test::elapsed(start);
+	cout << "find newlines: " << scalar_time << "s scalar, " <<
+		vector_time << "s find_char (" << repeats << " passes)" << endl;
+	test::check(vector_sum,scalar_sum,"newline positions",errors);
+
+	compare(by_lines,by_buffer,errors);
+	compare(by_stream,by_buffer,errors);
+	check_validation(errors);
+	check_duplicates(errors);
+	check_write_deferred(errors);
+	check_write(errors);
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
@@ -0,0 +1,160 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Test the outcome of dependency resolution for a sequence of changes
+// to the selected status table, and that resolving an overlay on another
+// table gives the same outcome without altering that table.
+
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include "libpkg/filesystem.h"
+#include "libpkg/status_table.h"
+#include "libpkg/pkgbase.h"
+
+#include "test_util.h"
+
+using std::string;
+
+using pkg::pkgbase;
+using pkg::status;
+using pkg::status_table;
+
+/** The package index. */
+const char* const available=
+	"Package: a\nVersion: 1.0-1\nDepends: b\n\n"
+	"Package: b\nVersion: 1.0-1\nDepends: c (>= 1.0)\n\n"
+	"Package: c\nVersion: 1.0-1\n\n"
+	"Package: c\nVersion: 2.0-1\n\n"
+	"Package: d\nVersion: 1.0-1\nDepends: e | f\n\n"
+	"Package: f\nVersion: 1.0-1\n\n"
+	"Package: g\nVersion: 1.0-1\nDepends: missing\n\n"
+	"Package: h\nVersion: 1.0-1\nDepends: b, f\n\n";
+
+/** List the packages selected for installation.
+ * Auto-installed packages are marked with an asterisk.
+ * @param table the status table
+ * @return the package names and versions, separated by spaces
+ */
+string contents(const status_table& table)
+{
+	std::ostringstream out;
+	for (status_table::const_iterator i=table.begin();i!=table.end();++i)
+	{
+		const status& st=i->second;
+		if (st.state()<status::state_installed) continue;
+		if (out.tellp()) out << ' ';
+		out << i->first << '=' << st.version();
+		if (st.flag(status::flag_auto)) out << '*';
+	}
+	return out.str();
+}
+
+/** Select a package for installation or removal, then fix dependencies.
+ * @param pb the package database
+ * @param table the table to be fixed
+ * @param pkgname the package name
+ * @param install true to install the package, false to remove it
+ * @return the result of fixing dependencies
+ */
+bool select(pkgbase& pb,status_table& table,const string& pkgname,
+	bool install)
+{
+	status st=table[pkgname];
+	if (install)
+	{
+		const pkg::env_packages_table::best& best=pb.env_packages()[pkgname];
+		st.state(status::state_installed);
+		st.version(best.pkgvrsn);
+		st.environment_id(best.pkgenv);
+		st.flag(status::flag_auto,false);
+	}
+	else st.state(status::state_removed);
+	table.insert(pkgname,st);
+	std::set<string> seed;
+	seed.insert(pkgname);
+	return pb.fix_dependencies(table,seed);
+}
+
+/** Apply a sequence of changes to a status table.
+ * The outcome of each step is checked.
+ * @param pb the package database
+ * @param table the table to be changed
+ * @param errors the error count
+ */
+void apply_changes(pkgbase& pb,status_table& table,unsigned int* errors)
+{
+	test::check(select(pb,table,"a",true),"install a",errors);
+	test::check(contents(table),string("a=1.0-1 b=1.0-1* c=2.0-1*"),
+		"install a contents",errors);
+
+	test::check(select(pb,table,"d",true),"install d",errors);
+	test::check(contents(table),
+		string("a=1.0-1 b=1.0-1* c=2.0-1* d=1.0-1 f=1.0-1*"),
+		"install alternative",errors);
+
+	test::check(select(pb,table,"h",true),"install h",errors);
+	test::check(contents(table),
+		string("a=1.0-1 b=1.0-1* c=2.0-1* d=1.0-1 f=1.0-1* h=1.0-1"),
+		"install shared dependencies",errors);
+
+	test::check(!select(pb,table,"g",true),"install unsatisfiable",errors);
+	test::check(select(pb,table,"g",false),"abandon unsatisfiable",errors);
+	test::check(contents(table),
+		string("a=1.0-1 b=1.0-1* c=2.0-1* d=1.0-1 f=1.0-1* h=1.0-1"),
+		"abandon unsatisfiable contents",errors);
+
+	test::check(select(pb,table,"c",false),"remove c",errors);
+	test::check(contents(table),string("d=1.0-1 f=1.0-1*"),
+		"remove dependents",errors);
+
+	pb.remove_auto(table);
+	test::check(contents(table),string("d=1.0-1 f=1.0-1*"),
+		"keep needed auto",errors);
+
+	test::check(select(pb,table,"d",false),"remove d",errors);
+	pb.remove_auto(table);
+	test::check(contents(table),string(),"remove unneeded auto",errors);
+}
+
+/** Check dependency resolution on the selected table and an overlay.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	string pathname=test::fixture_pathname("Pkg");
+	pkg::create_directory(pathname);
+	test::write_fixture("Pkg.Available",available);
+	test::write_fixture("Pkg.Version","2");
+	pkgbase pb(pathname,pathname,pathname);
+
+	// Resolve the selected status table.
+	pb.selstat().clear();
+	apply_changes(pb,pb.selstat(),errors);
+
+	// Resolve an overlay on a table that is not changed.
+	status_table base;
+	status_table overlay(&base);
+	apply_changes(pb,overlay,errors);
+	test::check(contents(base),string(),"overlay base unchanged",errors);
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
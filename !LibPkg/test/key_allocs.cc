@@ -0,0 +1,163 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark counting the number of memory allocations made by the
+// operations that dependency resolution performs for each package:
+// copying a status record, building a binary control table key from
+// the version and environment held in the status record, looking up
+// that key, and copying the key that is found.  Only the version is
+// held in a short_string: the package name, environment and status
+// strings are std::string, and are only free to copy where std::string
+// is reference counted.
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include "libpkg/status.h"
+#include "libpkg/binary_control_table.h"
+
+#include "test_util.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+
+using pkg::status;
+using pkg::version;
+
+typedef pkg::binary_control_table::key_type key_type;
+
+/** The number of packages in the synthetic status table. */
+const unsigned int package_count=2000;
+
+/** The number of memory allocations made. */
+unsigned long allocations=0;
+
+// All forms of the global allocation and deallocation functions are
+// replaced, so that memory is always released by the counterpart of
+// the function that allocated it.
+
+void* operator new(std::size_t size)
+{
+	++allocations;
+	if (void* p=std::malloc(size?size:1)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p,std::size_t size) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p,std::size_t size) noexcept
+{
+	std::free(p);
+}
+
+/** Generate a synthetic status table.
+ * @param count the number of packages
+ * @return the status table
+ */
+std::map<string,status> make_status(unsigned int count)
+{
+	std::map<string,status> result;
+	for (unsigned int i=0;i!=count;++i)
+	{
+		std::ostringstream pkgname;
+		pkgname << "Package" << i;
+		std::ostringstream pkgvrsn;
+		pkgvrsn << (i%7) << "." << (i%13) << "." << (i%5) << "-" << (i%3+1);
+		result[pkgname.str()]=status(status::state_installed,pkgvrsn.str(),
+			(i%4)?"u":"a");
+	}
+	return result;
+}
+
+/** Count the allocations made by each operation.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	std::map<string,status> selstat=make_status(package_count);
+	std::map<key_type,unsigned int> control;
+	for (std::map<string,status>::const_iterator i=selstat.begin();
+		i!=selstat.end();++i)
+	{
+		control[key_type(i->first,i->second.version(),
+			i->second.environment_id())]=0;
+	}
+
+	unsigned long start=allocations;
+	for (std::map<string,status>::const_iterator i=selstat.begin();
+		i!=selstat.end();++i)
+	{
+		status copy=i->second;
+	}
+	cout << "Copy status:       " << allocations-start << " allocations" <<
+		endl;
+
+	start=allocations;
+	unsigned int found=0;
+	for (std::map<string,status>::const_iterator i=selstat.begin();
+		i!=selstat.end();++i)
+	{
+		key_type key(i->first,i->second.version(),
+			i->second.environment_id());
+		if (control.find(key)!=control.end()) ++found;
+	}
+	unsigned long key_allocations=allocations-start;
+	cout << "Build and find key: " << key_allocations <<
+		" allocations" << endl;
+
+	start=allocations;
+	for (std::map<key_type,unsigned int>::const_iterator i=
+		control.begin();i!=control.end();++i)
+	{
+		key_type copy=i->first;
+	}
+	unsigned long copy_allocations=allocations-start;
+	cout << "Copy key:          " << copy_allocations << " allocations" <<
+		endl;
+
+	test::check(key_allocations,0ul,"build and find key allocations",errors);
+	test::check(copy_allocations,0ul,"copy key allocations",errors);
+	test::check(found,package_count,"keys found",errors);
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
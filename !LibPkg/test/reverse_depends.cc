@@ -0,0 +1,221 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark comparing a full scan of the binary control table with
+// reverse_dependency_index when finding the packages which depend on
+// a given package, in a synthetic universe of 10000 packages.
+
+#include <ctime>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "libpkg/binary_control_table.h"
+#include "libpkg/env_checker.h"
+#include "libpkg/status_table.h"
+#include "libpkg/reverse_dependency_index.h"
+
+#include "test_util.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+
+using pkg::binary_control;
+using pkg::binary_control_table;
+using pkg::dependency;
+using pkg::reverse_dependency_index;
+using pkg::status;
+using pkg::status_table;
+using pkg::table;
+
+/** The number of packages in the synthetic universe. */
+const unsigned int package_count=10000;
+
+/** The number of packages for which dependents are found by scanning. */
+const unsigned int scan_count=100;
+
+/** Get the name of a synthetic package.
+ * @param i the package number
+ * @return the package name
+ */
+string package_name(unsigned int i)
+{
+	std::ostringstream out;
+	out << "Package" << i;
+	return out.str();
+}
+
+/** Generate a control record for a synthetic package.
+ * Packages depend on lower-numbered packages, some of them by way of
+ * alternatives, and every tenth package has a second version.
+ * @param i the package number
+ * @param vrsn the package version
+ * @return the control record
+ */
+binary_control make_record(unsigned int i,const string& vrsn)
+{
+	binary_control ctrl;
+	ctrl["Package"]=package_name(i);
+	ctrl["Version"]=vrsn;
+	if (i>=10)
+	{
+		std::ostringstream depends;
+		depends << package_name(i/2) << " (>= 1.0), " <<
+			package_name(i%10);
+		if (i%3==0) depends << " | " << package_name(i/3);
+		ctrl["Depends"]=depends.str();
+	}
+	ctrl["Description"]="Synthetic package";
+	return ctrl;
+}
+
+/** Find the packages which depend on a package by scanning every record.
+ * @param control the binary control table
+ * @param pkgname the package name
+ * @return the names of the dependent packages
+ */
+std::set<string> scan_dependents(const binary_control_table& control,
+	const string& pkgname)
+{
+	std::set<string> result;
+	std::vector<std::vector<dependency> > deps;
+	for (binary_control_table::const_iterator i=control.begin();
+		i!=control.end();++i)
+	{
+		string deplist=i->second.depends();
+		deps.clear();
+		pkg::parse_dependency_list(deplist.begin(),deplist.end(),&deps);
+		for (unsigned int j=0;j!=deps.size();++j)
+		{
+			for (unsigned int k=0;k!=deps[j].size();++k)
+			{
+				if (deps[j][k].pkgname()==pkgname)
+					result.insert(i->first.pkgname);
+			}
+		}
+	}
+	return result;
+}
+
+/** Get the names of the packages for a list of records.
+ * @param records the records
+ * @return the package names
+ */
+std::set<string> names(const reverse_dependency_index::record_list& records)
+{
+	std::set<string> result;
+	for (unsigned int i=0;i!=records.size();++i)
+		result.insert(records[i]->first.pkgname);
+	return result;
+}
+
+/** Compare the index with a full scan.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	pkg::env_checker_ptr env_checker("ModuleIDs");
+
+	// Build the synthetic universe.
+	binary_control_table control("");
+	{
+		table::batch control_batch(control);
+		for (unsigned int i=0;i!=package_count;++i)
+		{
+			control.insert(make_record(i,"1.0-1"));
+			if (i%10==0) control.insert(make_record(i,"1.1-1"));
+		}
+	}
+
+	clock_t start=clock();
+	reverse_dependency_index index(control);
+	cout << "Build index:    " << test::elapsed(start) << "s" << endl;
+
+	// Find dependents by scanning.
+	std::vector<std::set<string> > scanned;
+	start=clock();
+	for (unsigned int i=0;i!=scan_count;++i)
+		scanned.push_back(scan_dependents(control,package_name(i)));
+	double scan_time=test::elapsed(start);
+	cout << "Full scan:      " << scan_time/scan_count <<
+		"s per package" << endl;
+
+	// Find dependents using the index.
+	start=clock();
+	unsigned long found=0;
+	for (unsigned int i=0;i!=package_count;++i)
+		found+=index.dependents(package_name(i)).size();
+	double index_time=test::elapsed(start);
+	cout << "Index lookup:   " << index_time/package_count <<
+		"s per package (" << found << " records)" << endl;
+
+	for (unsigned int i=0;i!=scan_count;++i)
+	{
+		if (names(index.dependents(package_name(i)))!=scanned[i])
+		{
+			cout << "Dependents of " << package_name(i) <<
+				" differ" << endl;
+			++*errors;
+		}
+	}
+
+	// Package10 is depended on by Package20, Package21 and (as an
+	// alternative) Package30.  Only installed packages for which
+	// the installed version is in the table should be counted.
+	const string& pkgenv=control.begin()->first.pkgenv;
+	status_table curstat;
+	curstat.insert(package_name(20),
+		status(status::state_installed,"1.0-1",pkgenv));
+	curstat.insert(package_name(21),
+		status(status::state_installed,"0.9-1",pkgenv));
+	curstat.insert(package_name(22),
+		status(status::state_installed,"1.0-1",pkgenv));
+	curstat.insert(package_name(30),
+		status(status::state_installed,"1.1-1",pkgenv));
+	std::set<string> expected;
+	expected.insert(package_name(20));
+	expected.insert(package_name(30));
+	if (index.required_by(package_name(10),curstat)!=expected)
+	{
+		cout << "Installed dependents of " << package_name(10) <<
+			" incorrect" << endl;
+		++*errors;
+	}
+
+	// The index should follow changes to the table.
+	binary_control ctrl=make_record(7,"2.0-1");
+	ctrl["Depends"]=package_name(1);
+	control.insert(ctrl);
+	reverse_dependency_index fresh(control);
+	for (unsigned int i=0;i!=scan_count;++i)
+	{
+		if (names(index.dependents(package_name(i)))!=
+			names(fresh.dependents(package_name(i))))
+		{
+			cout << "Index not updated for " << package_name(i) <<
+				endl;
+			++*errors;
+		}
+	}
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
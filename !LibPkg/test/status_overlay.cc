@@ -0,0 +1,222 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Test that an overlay status table presents the union of its own
+// content and that of the underlying table without altering the latter,
+// and that transaction_plan classifies the differences correctly.
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "libpkg/binary_control_table.h"
+#include "libpkg/env_checker.h"
+#include "libpkg/status_table.h"
+#include "libpkg/transaction_plan.h"
+
+#include "test_util.h"
+
+using std::string;
+
+using pkg::binary_control;
+using pkg::binary_control_table;
+using pkg::status;
+using pkg::status_table;
+using pkg::transaction_plan;
+
+/** Make an installed package status.
+ * The environment is that of a control record with no Environment field.
+ * @param vrsn the package version
+ * @return the package status
+ */
+status installed(const string& vrsn)
+{
+	return status(status::state_installed,vrsn,
+		binary_control().environment_id());
+}
+
+/** Make a control record.
+ * @param pkgname the package name
+ * @param vrsn the package version
+ * @param size the package size
+ * @return the control record
+ */
+binary_control make_record(const string& pkgname,const string& vrsn,
+	unsigned int size)
+{
+	std::ostringstream size_text;
+	size_text << size;
+	std::ostringstream installed_text;
+	installed_text << size*2;
+	binary_control ctrl;
+	ctrl["Package"]=pkgname;
+	ctrl["Version"]=vrsn;
+	ctrl["Size"]=size_text.str();
+	ctrl["Installed-Size"]=installed_text.str();
+	ctrl["Description"]="Test package";
+	return ctrl;
+}
+
+/** List the packages in a status table.
+ * @param table the status table
+ * @return the package names and versions, separated by spaces
+ */
+string contents(const status_table& table)
+{
+	std::ostringstream out;
+	for (status_table::const_iterator i=table.begin();i!=table.end();++i)
+	{
+		if (i!=table.begin()) out << ' ';
+		out << i->first << '=' << i->second.version();
+	}
+	return out.str();
+}
+
+/** List the packages in a status table in reverse order.
+ * @param table the status table
+ * @return the package names, separated by spaces
+ */
+string reverse_contents(const status_table& table)
+{
+	typedef std::reverse_iterator<status_table::const_iterator>
+		reverse_iterator;
+	std::ostringstream out;
+	for (reverse_iterator i(table.end());i!=reverse_iterator(table.begin());
+		++i)
+	{
+		if (i!=reverse_iterator(table.end())) out << ' ';
+		out << i->first;
+	}
+	return out.str();
+}
+
+/** Join a list of package names.
+ * @param names the package names
+ * @return the names, separated by spaces
+ */
+string join(const std::vector<string>& names)
+{
+	string result;
+	for (unsigned int i=0;i!=names.size();++i)
+	{
+		if (i) result+=' ';
+		result+=names[i];
+	}
+	return result;
+}
+
+/** Check overlay iteration, lookup and planning.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	pkg::env_checker_ptr env_checker("ModuleIDs");
+
+	status_table base;
+	base.insert("a",installed("1.0-1"));
+	base.insert("c",installed("1.0-1"));
+	base.insert("e",installed("1.0-1"));
+
+	status_table overlay(&base);
+	test::check(contents(overlay),string("a=1.0-1 c=1.0-1 e=1.0-1"),
+		"initial overlay",errors);
+
+	overlay.insert("b",installed("2.0-1"));
+	overlay.insert("c",installed("2.0-1"));
+	overlay.insert("f",installed("2.0-1"));
+	test::check(contents(overlay),
+		string("a=1.0-1 b=2.0-1 c=2.0-1 e=1.0-1 f=2.0-1"),
+		"merged iteration",errors);
+	test::check(contents(base),string("a=1.0-1 c=1.0-1 e=1.0-1"),
+		"base unchanged",errors);
+	test::check(reverse_contents(overlay),string("f e c b a"),
+		"reverse iteration",errors);
+	test::check(reverse_contents(base),string("e c a"),
+		"reverse iteration of base",errors);
+	status_table::const_iterator e=overlay.find("e");
+	test::check((--e)->second.version(),string("2.0-1"),
+		"decrement to package in both tables",errors);
+	status_table::const_iterator c=overlay.find("c");
+	test::check((--c)->first,string("b"),"decrement to overlay",errors);
+	test::check((--c)->first,string("a"),"decrement to base",errors);
+	test::check(c==overlay.begin(),"decrement to begin",errors);
+	test::check((++c)->first,string("b"),"increment after decrement",
+		errors);
+	test::check(overlay["c"].version(),string("2.0-1"),"lookup overlay",
+		errors);
+	test::check(overlay["e"].version(),string("1.0-1"),"lookup base",errors);
+	test::check(overlay.find("a")->first,string("a"),"find base",errors);
+	test::check(overlay.find("b")->first,string("b"),"find overlay",errors);
+	test::check(overlay.find("d")==overlay.end(),"find missing",errors);
+
+	// Packages set while iterating must be visited if they follow
+	// the current position, as they are during dependency resolution.
+	string visited;
+	for (status_table::const_iterator i=overlay.begin();
+		i!=overlay.end();++i)
+	{
+		if (i->first=="a")
+		{
+			overlay.insert("d",installed("2.0-1"));
+			overlay.insert("e",installed("2.0-1"));
+		}
+		visited+=i->first+'='+i->second.version()+' ';
+	}
+	test::check(visited,
+		string("a=1.0-1 b=2.0-1 c=2.0-1 d=2.0-1 e=2.0-1 f=2.0-1 "),
+		"insert while iterating",errors);
+
+	bool rejected=false;
+	try
+	{
+		status_table nested(&overlay);
+	}
+	catch (std::invalid_argument&)
+	{
+		rejected=true;
+	}
+	test::check(rejected,"nested overlay rejected",errors);
+
+	// Plan the changes from the base table to the overlay.
+	binary_control_table control("");
+	control.insert(make_record("a","1.0-1",100));
+	control.insert(make_record("b","2.0-1",200));
+	control.insert(make_record("c","1.0-1",300));
+	control.insert(make_record("c","2.0-1",400));
+	control.insert(make_record("e","1.0-1",500));
+	overlay.insert("a",status());
+	transaction_plan plan(base,overlay,control);
+	test::check(join(plan.install()),string("b d f"),"plan install",errors);
+	test::check(join(plan.upgrade()),string("c e"),"plan upgrade",errors);
+	test::check(join(plan.remove()),string("a"),"plan remove",errors);
+	test::check(plan.download_size(),transaction_plan::size_type(600),
+		"plan download size",errors);
+	test::check(plan.unpacked_size(),transaction_plan::size_type(1200),
+		"plan unpacked size",errors);
+	test::check(plan.removed_size(),transaction_plan::size_type(1800),
+		"plan removed size",errors);
+
+	overlay.rollback();
+	test::check(contents(overlay),string("a=1.0-1 c=1.0-1 e=1.0-1"),
+		"rollback",errors);
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
@@ -0,0 +1,133 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Test that control records in a binary control table share the storage
+// of repeated field values, and that the string pool reports only the
+// sharing that actually takes place.
+
+#include <iostream>
+
+#include "libpkg/binary_control.h"
+#include "libpkg/binary_control_table.h"
+#include "libpkg/env_checker.h"
+#include "libpkg/string_pool.h"
+
+#include "test_util.h"
+
+using std::string;
+using pkg::control;
+using pkg::binary_control;
+using pkg::binary_control_table;
+using pkg::shared_string;
+using pkg::string_pool;
+
+/** The package index.
+ * Version 1.0-1 (5 bytes) is used by four records, Section Utilities
+ * (9 bytes) by three and Maintainer M <m@x> (7 bytes) by three.
+ */
+const char* const available=
+	"Package: a\nVersion: 1.0-1\nSection: Utilities\n"
+	"Maintainer: M <m@x>\nDescription: A\n\n"
+	"Package: b\nVersion: 1.0-1\nSection: Utilities\n"
+	"Maintainer: M <m@x>\nDescription: B\n\n"
+	"Package: c\nVersion: 1.0-1\nSection: Utilities\n"
+	"Maintainer: M <m@x>\nDescription: C\n\n"
+	"Package: d\nVersion: 1.0-1\nSection: Games\n\n";
+
+/** The number of bytes saved by sharing values in the package index. */
+const unsigned long index_saving=3*5+2*9+2*7;
+
+/** Get the value of a field of a package in a binary control table.
+ * @param table the binary control table
+ * @param pkgname the package name
+ * @param field the field
+ * @return the value
+ */
+const shared_string& value(const binary_control_table& table,
+	const string& pkgname,control::field_type field)
+{
+	return table[pkgname].find(field)->second;
+}
+
+/** Check the sharing of values by a binary control table.
+ * @param table the binary control table
+ * @param name the name of the table, for reporting errors
+ * @param errors the error count
+ */
+void check_table(const binary_control_table& table,const string& name,
+	unsigned int* errors)
+{
+	test::check(string_pool::identical(
+		value(table,"a",control::field_section),
+		value(table,"c",control::field_section)),
+		(name+": repeated value shared").c_str(),errors);
+	test::check(!string_pool::identical(
+		value(table,"a",control::field_section),
+		value(table,"d",control::field_section)),
+		(name+": different values not shared").c_str(),errors);
+	test::check(table.pool().bytes_saved(),index_saving,
+		(name+": bytes saved").c_str(),errors);
+}
+
+/** Check the string pool on its own and in a binary control table.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	// Only values held outside the pool count as savings.
+	string_pool pool;
+	shared_string x1=pool.intern(string("xyz"));
+	test::check(pool.bytes_saved(),0ul,"single use not saved",errors);
+	shared_string x2=pool.intern(shared_string("xyz"));
+	test::check(string_pool::identical(x1,x2),"interned values shared",
+		errors);
+	test::check(pool.size(),1u,"one value held",errors);
+	test::check(pool.bytes_saved(),3ul,"second use saved",errors);
+	x2=shared_string("xyz");
+	test::check(!string_pool::identical(x1,x2),"copy not shared",errors);
+	test::check(string_pool::equal(x1,x2),"copy equal",errors);
+	test::check(pool.bytes_saved(),0ul,"released use not saved",errors);
+
+	// Values are shared whether the index is parsed or read from the
+	// snapshot written when it was parsed.
+	pkg::env_checker_ptr env_checker("ModuleIDs");
+	string pathname=test::write_fixture("Available",available);
+	binary_control_table parsed(pathname);
+	check_table(parsed,"parsed",errors);
+	binary_control_table loaded(pathname);
+	check_table(loaded,"snapshot",errors);
+
+	// Inserted records share values already in the table.
+	{
+		binary_control ctrl;
+		ctrl["Package"]="e";
+		ctrl["Version"]="2.0-1";
+		ctrl["Section"]="Utilities";
+		loaded.insert(ctrl);
+	}
+	test::check(string_pool::identical(
+		value(loaded,"a",control::field_section),
+		value(loaded,"e",control::field_section)),
+		"inserted value shared",errors);
+	test::check(loaded.pool().bytes_saved(),index_saving+9,
+		"inserted bytes saved",errors);
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
@@ -0,0 +1,122 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Test that watchers are notified once when a batch of changes to a
+// table ends, including when the batch ends because of an exception.
+
+#include <iostream>
+#include <stdexcept>
+
+#include "libpkg/table.h"
+
+#include "test_util.h"
+
+using pkg::table;
+
+/** A table which can be changed on demand. */
+class test_table:
+	public table
+{
+public:
+	/** Make a change to the table. */
+	void change()
+		{ notify(); }
+};
+
+/** A watcher which counts notifications. */
+class test_watcher:
+	public table::watcher
+{
+public:
+	/** The number of notifications received. */
+	unsigned int count;
+
+	/** True if the next notification should throw an exception. */
+	bool fail;
+
+	/** Construct test watcher. */
+	test_watcher():
+		count(0),
+		fail(false)
+	{}
+
+	virtual void handle_change(table& t)
+	{
+		++count;
+		if (fail)
+		{
+			fail=false;
+			throw std::runtime_error("watcher failed");
+		}
+	}
+};
+
+/** Check the notifications received for each kind of batch.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	test_table t;
+	test_watcher w;
+	w.watch(t);
+
+	t.change();
+	test::check(w.count,1u,"unbatched change",errors);
+
+	{
+		table::batch outer(t);
+		t.change();
+		t.change();
+		{
+			table::batch inner(t);
+			t.change();
+		}
+		test::check(w.count,1u,"nested batch",errors);
+	}
+	test::check(w.count,2u,"end of batch",errors);
+
+	{
+		table::batch empty(t);
+	}
+	test::check(w.count,2u,"empty batch",errors);
+
+	try
+	{
+		table::batch b(t);
+		t.change();
+		w.fail=true;
+		throw std::logic_error("batch failed");
+	}
+	catch (std::logic_error&)
+	{}
+	test::check(w.count,3u,"batch ended by exception",errors);
+
+	try
+	{
+		table::batch b(t);
+		t.change();
+		w.fail=true;
+	}
+	catch (std::runtime_error&)
+	{}
+	test::check(w.count,4u,"watcher exception",errors);
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
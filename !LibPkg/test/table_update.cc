@@ -0,0 +1,108 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Test that a binary control table is left consistent, and that its
+// watchers are notified, when a package index cannot be parsed.
+
+#include <iostream>
+
+#include "libpkg/control.h"
+#include "libpkg/binary_control_table.h"
+#include "libpkg/env_checker.h"
+
+#include "test_util.h"
+
+using std::string;
+using pkg::control;
+using pkg::binary_control_table;
+
+/** A watcher which counts notifications. */
+class test_watcher:
+	public pkg::table::watcher
+{
+public:
+	/** The number of notifications received. */
+	unsigned int count;
+
+	/** Construct test watcher. */
+	test_watcher():
+		count(0)
+	{}
+
+	virtual void handle_change(pkg::table& t)
+		{ ++count; }
+};
+
+/** Check the effect of updating from a malformed package index.
+ * @param errors the error count
+ */
+void checks(unsigned int* errors)
+{
+	pkg::env_checker_ptr env_checker("ModuleIDs");
+	string pathname=test::write_fixture("Available",
+		"Package: alpha\nVersion: 1.0-1\n\n"
+		"Package: beta\nVersion: 1.0-1\n\n"
+		"Package: gamma\nVersion: 1.0-1\n\n");
+	binary_control_table table(pathname);
+	test_watcher w;
+	w.watch(table);
+	test::check(table.records("gamma").size(),size_t(1),
+		"gamma before update",errors);
+
+	// Replace the index with one that has a malformed record between
+	// two good ones.
+	test::write_fixture("Available",
+		"Package: alpha\nVersion: 1.0-2\n\n"
+		"Package: delta\nVersion: 1.0-1\nNot a field\n\n"
+		"Package: gamma\nVersion: 1.0-2\n\n");
+	bool thrown=false;
+	try
+	{
+		table.update();
+	}
+	catch (control::parse_error&)
+	{
+		thrown=true;
+	}
+	test::check(thrown,"parse error thrown",errors);
+	test::check(w.count,1u,"watcher notified",errors);
+
+	// The record before the error is kept, and is found through the
+	// index.  Nothing from the old index remains.
+	test::check(table.records("alpha").size(),size_t(1),
+		"alpha after update",errors);
+	test::check(table["alpha"].version(),string("1.0-2"),
+		"alpha version after update",errors);
+	test::check(table.records("beta").size(),size_t(0),
+		"beta after update",errors);
+	test::check(table.records("gamma").size(),size_t(0),
+		"gamma after update",errors);
+
+	// Once the index is corrected the table can be updated again.
+	test::write_fixture("Available",
+		"Package: alpha\nVersion: 1.0-2\n\n"
+		"Package: gamma\nVersion: 1.0-2\n\n");
+	table.update();
+	test::check(w.count,2u,"watcher notified after repair",errors);
+	test::check(table.records("gamma").size(),size_t(1),
+		"gamma after repair",errors);
+}
+
+int main(int argc,char* argv[])
+{
+	return test::run(checks);
+}
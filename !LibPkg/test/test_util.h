@@ -0,0 +1,144 @@
+// This file is part of LibPkg.
+//
+// Copyright 2003-2020 Graham Shaw
+// Copyright 2018-2020 Alan Buckley.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBPKG_TEST_UTIL
+#define LIBPKG_TEST_UTIL
+
+// Support shared by the LibPkg tests.  Each test is a standalone program
+// which prints the number of failed checks, and returns a non-zero exit
+// status if there were any.
+
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "libpkg/filesystem.h"
+
+/** The directory in which test fixtures are created. */
+#ifndef LIBPKG_TEST_FIXTURES
+#define LIBPKG_TEST_FIXTURES "<Wimp$ScrapDir>.LibPkgTest"
+#endif
+
+namespace test {
+
+using std::string;
+using std::cout;
+using std::endl;
+
+/** Check that a condition holds.
+ * @param condition the condition
+ * @param name the name of the check
+ * @param errors the error count, incremented if the check fails
+ * @return the condition
+ */
+inline bool check(bool condition,const char* name,unsigned int* errors)
+{
+	if (!condition)
+	{
+		cout << "ERROR: " << name << endl;
+		++*errors;
+	}
+	return condition;
+}
+
+/** Check that a value is as expected.
+ * @param actual the actual value
+ * @param expected the expected value
+ * @param name the name of the check
+ * @param errors the error count, incremented if the check fails
+ * @return true if the values are equal, otherwise false
+ */
+template<class T>
+bool check(const T& actual,const T& expected,const char* name,
+	unsigned int* errors)
+{
+	if (!(actual==expected))
+	{
+		cout << "ERROR: " << name << " (" << actual << ", " <<
+			expected << " expected)" << endl;
+		++*errors;
+		return false;
+	}
+	return true;
+}
+
+/** Get the time elapsed since a given clock value.
+ * @param start the starting clock value
+ * @return the elapsed time in seconds
+ */
+inline double elapsed(clock_t start)
+{
+	return double(clock()-start)/CLOCKS_PER_SEC;
+}
+
+/** Get the pathname of a test fixture.
+ * The fixture directory is created if it does not already exist.
+ * @param leafname the leafname of the fixture
+ * @return the pathname
+ */
+inline string fixture_pathname(const string& leafname)
+{
+	static bool created=false;
+	if (!created)
+	{
+		pkg::create_directory(LIBPKG_TEST_FIXTURES);
+		created=true;
+	}
+	return string(LIBPKG_TEST_FIXTURES)+string(".")+leafname;
+}
+
+/** Write a test fixture.
+ * @param leafname the leafname of the fixture
+ * @param content the required content
+ * @return the pathname of the fixture
+ */
+inline string write_fixture(const string& leafname,const string& content)
+{
+	string pathname=fixture_pathname(leafname);
+	std::ofstream out(pathname.c_str());
+	out << content;
+	out.close();
+	if (!out) throw std::runtime_error("failed to write "+pathname);
+	return pathname;
+}
+
+/** Run the checks that make up a test.
+ * Any exception thrown by the checks is reported as a failure.
+ * @param checks the function which performs the checks
+ * @return the exit status of the test
+ */
+inline int run(void (*checks)(unsigned int* errors))
+{
+	unsigned int errors=0;
+	try
+	{
+		checks(&errors);
+	}
+	catch (std::exception& ex)
+	{
+		cout << ex.what() << endl;
+		++errors;
+	}
+	cout << "Errors: " << errors << endl;
+	return (errors)?1:0;
+}
+
+}; /* namespace test */
+
+#endif
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
@@ -162,6 +164,98 @@ void test_conv(const char** table,unsigned int size,const string& name,
 	}
 }
 
+int cmp_key(const version& lhs,const version& rhs)
+{
+	int cmp=lhs.sort_key().compare(rhs.sort_key());
+	return (cmp<0)?-1:(cmp>0)?+1:0;
+}
+
+void test_key_eq(const char** table,unsigned int size,const string& name,
+	unsigned int* errors)
+{
+	for (unsigned int i=0;i!=size;++i)
+	{
+		for (unsigned int j=0;j!=size;++j)
+		{
+			version lhs(table[i]);
+			version rhs(table[j]);
+			if (lhs.sort_key()!=rhs.sort_key())
+			{
+				cout << "ERROR: " << name << " (" << i << "," << j
+					<< ") failed" << endl;
+				if (errors) ++*errors;
+			}
+		}
+	}
+}
+
+void test_key_ineq(const char** table,unsigned int size,const string& name,
+	unsigned int* errors)
+{
+	for (unsigned int i=0;i!=size;++i)
+	{
+		for (unsigned int j=0;j!=i;++j)
+		{
+			version lhs(table[i]);
+			version rhs(table[j]);
+			if ((cmp_key(lhs,rhs)!=+1)||(cmp_key(rhs,lhs)!=-1))
+			{
+				cout << "ERROR: " << name << " (" << i << "," << j
+					<< ") failed" << endl;
+				if (errors) ++*errors;
+			}
+		}
+	}
+}
+
+/** Generate a random version component.
+ * The alphabet is small so that equal and nearly equal components,
+ * leading zeros and long digit runs are all common.
+ * @param alphabet the characters from which to choose
+ * @param max_length the maximum length
+ * @return the component
+ */
+string random_component(const char* alphabet,unsigned int max_length)
+{
+	unsigned int count=strlen(alphabet);
+	unsigned int length=rand()%(max_length+1);
+	string result;
+	for (unsigned int i=0;i!=length;++i)
+	{
+		if (rand()%16==0) result.append(12+rand()%4,'0'+rand()%10);
+		else result.push_back(alphabet[rand()%count]);
+	}
+	return result;
+}
+
+/** Generate a random version.
+ * @return the version
+ */
+version random_version()
+{
+	string epoch=(rand()%4==0)?random_component("0012",2):string();
+	string upstream=random_component("000119~~aAz+.-:",8);
+	string package=(rand()%2)?random_component("00119~~aZ+.",5):string();
+	return version(epoch,upstream,package);
+}
+
+void test_key_random(unsigned int count,const string& name,
+	unsigned int* errors)
+{
+	srand(1);
+	for (unsigned int i=0;i!=count;++i)
+	{
+		version lhs=random_version();
+		version rhs=random_version();
+		if (cmp_key(lhs,rhs)!=lhs.compare(rhs))
+		{
+			cout << "ERROR: " << name << " (" << string(lhs) << "," <<
+				string(rhs) << ") failed" << endl;
+			if (errors) ++*errors;
+		}
+	}
+}
+
 void test_version(unsigned int* errors)
 {
 	try
@@ -176,6 +270,15 @@ void test_version(unsigned int* errors)
 			"inequality test B",errors);
 		test_ineq(conv_table,sizeof(conv_table)/sizeof(const char*),
 			"conversion test",errors);
+		test_key_eq(eq_table_a,sizeof(eq_table_a)/sizeof(const char*),
+			"sort key equality test A",errors);
+		test_key_eq(eq_table_b,sizeof(eq_table_b)/sizeof(const char*),
+			"sort key equality test B",errors);
+		test_key_ineq(ineq_table_a,sizeof(ineq_table_a)/sizeof(const char*),
+			"sort key inequality test A",errors);
+		test_key_ineq(ineq_table_b,sizeof(ineq_table_b)/sizeof(const char*),
+			"sort key inequality test B",errors);
+		test_key_random(200000,"sort key random test",errors);
 		if (!errors) cout << "No errors" << endl;
 	}
 	catch (const exception& ex)